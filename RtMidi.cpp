@@ -44,6 +44,26 @@
 #include <algorithm>
 #include <functional>
 #include <cerrno>
+#include <new>
+#include <chrono>
+#include <map>
+#if defined( _WIN32 ) && !defined( __CYGWIN__ )
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#endif
+#if defined( __APPLE__ )
+#include <mach/mach_time.h>
+#endif
+#if defined( __linux__ )
+#include <sys/eventfd.h>
+#endif
 #ifndef RTMIDI_FALLTHROUGH
 #define RTMIDI_FALLTHROUGH
 #endif
@@ -89,6 +109,7 @@ extern "C" {
      { WINDOWS_MM, "winmm" , N_( "Windows Multimedia" ) },
      { WINDOWS_KS, "winks" , N_( "DirectX/Kernel Streaming" ) },
      { DUMMY, "dummy" , N_( "Dummy/NULL device" ) },
+     { LINUX_ALSA_RAW, "alsaraw" , N_( "ALSA raw MIDI" ) },
      { ALL_API, "allapi" , N_( "All available MIDI systems" ) },
     };
   const unsigned int rtmidi_num_api_names =
@@ -132,6 +153,12 @@ extern "C" {
      ALL_API,
 #if defined( __RTMIDI_DUMMY__ )
      DUMMY,
+#endif
+     // The sequencer lists the raw MIDI devices, too, and keeps them
+     // open as long as they are used. So, the raw backend is only
+     // used if it is selected explicitly.
+#if defined( __LINUX_ALSA__ )
+     LINUX_ALSA_RAW,
 #endif
     };
   extern "C" const size_t rtmidi_num_compiled_other_apis =
@@ -167,9 +194,16 @@ struct scoped_lock {
                     Error::WARNING );
     }
   }
+  // Lock an optional mutex. Nothing happens if m is 0.
+  scoped_lock( pthread_mutex_t * m )
+    : mutex( m )
+  {
+    if ( locking && mutex )
+      while ( pthread_mutex_lock( mutex ) == EINTR );
+  }
   ~scoped_lock( )
   {
-    if ( locking )
+    if ( locking && mutex )
       while ( pthread_mutex_unlock( mutex ) == EINTR );
   }
 };
@@ -290,11 +324,37 @@ public:
   void setPortName( const std::string& portName );
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
+  void setPortChangeCallback( PortChangeInterface * callback );
+  void setBufferSizes( const BufferSizes& sizes );
+  void setProtocol( MidiProtocol protocol );
   void sendMessage( const unsigned char * message, size_t size );
+  void sendMessages( const unsigned char * data,
+                     const size_t * offsets,
+                     size_t count );
+  size_t trySendMessages( const unsigned char * data,
+                          const size_t * offsets,
+                          size_t count );
+  int getPollDescriptor( );
+  void flush( );
+  void scheduleMessage( const unsigned char * message, size_t size,
+                        int64_t time );
 
 public:
   void * apiData_;
+  // Number of MIDI bytes in the output buffer.
+  size_t pendingBytes;
+  // The encoder holds an incomplete message.
+  bool encoderBusy;
+  // Status byte that data-only messages continue ( 0 if none ).
+  unsigned char runningStatus;
   void initialize( const std::string& clientName );
+  bool startQueue( );
+  bool encodeMessage( const unsigned char * message, size_t size,
+                      int64_t delay = -1 );
+  bool encodePackets( const unsigned char * message, size_t size,
+                      int64_t delay );
+  void autoFlush( );
+  void drainOutput( );
 };
 
 #endif
@@ -1431,15 +1491,19 @@ void MidiInCore :: midiInputCallback( const MIDIPacketList * list,
 
     // Calculate time stamp.
 
+    time = packet->timeStamp;
+    if ( time == 0 ) { // this happens when receiving asynchronous sysex messages
+      time = AudioGetCurrentHostTime( );
+    }
+    // The host time is the clock of Midi::getMonotonicTime.
+    if ( !continueSysex )
+      message.absoluteTime = AudioConvertHostTimeToNanos( time );
+
     if ( data->firstMessage ) {
       message.timeStamp = 0.0;
       data->firstMessage = false;
     }
     else {
-      time = packet->timeStamp;
-      if ( time == 0 ) { // this happens when receiving asynchronous sysex messages
-        time = AudioGetCurrentHostTime( );
-      }
       time -= apiData->lastTime;
       time = AudioConvertHostTimeToNanos( time );
       if ( !continueSysex )
@@ -1463,21 +1527,7 @@ void MidiInCore :: midiInputCallback( const MIDIPacketList * list,
       if ( !( data->ignoreFlags & IGNORE_SYSEX ) ) {
         if ( !continueSysex ) {
           // If not a continuing sysex message, invoke the user callback function or queue the message.
-          if ( data->userCallback ) {
-            data->userCallback->rtmidi_midi_in( message.timeStamp,
-                                                message.bytes );
-          }
-          else {
-            // As long as we haven't reached our queue size limit, push the message.
-            if ( !data->queue.push( message ) ) {
-              try {
-                data->error( RTMIDI_ERROR( rtmidi_gettext( "Error: Message queue limit reached." ),
-                                           Error::WARNING ) );
-              } catch ( Error& e ) {
-                // don't bother ALSA with an unhandled exception
-              }
-            }
-          }
+          data->deliverMessage( message.bytes, message.timeStamp, message.absoluteTime );
           message.bytes.clear( );
         }
       }
@@ -1529,21 +1579,7 @@ void MidiInCore :: midiInputCallback( const MIDIPacketList * list,
           message.bytes.assign( &packet->data[iByte], &packet->data[iByte+size] );
           if ( !continueSysex ) {
             // If not a continuing sysex message, invoke the user callback function or queue the message.
-            if ( data->userCallback ) {
-              data->userCallback->rtmidi_midi_in( message.timeStamp,
-                                                  message.bytes );
-            }
-            else {
-              // As long as we haven't reached our queue size limit, push the message.
-              if ( !data->queue.push( message ) ) {
-                try {
-                  data->error( RTMIDI_ERROR( rtmidi_gettext( "Error: Message queue limit reached." ),
-                                             Error::WARNING ) );
-                } catch ( Error& e ) {
-                  // don't bother WinMM with an unhandled exception
-                }
-              }
-            }
+            data->deliverMessage( message.bytes, message.timeStamp, message.absoluteTime );
             message.bytes.clear( );
           }
           iByte += size;
@@ -2135,8 +2171,226 @@ RTMIDI_NAMESPACE_END
 // ALSA header file.
 #include <alsa/asoundlib.h>
 
+// Sequencer clients can use Universal MIDI Packets since ALSA 1.2.10.
+#if SND_LIB_VERSION >= 0x01020a
+#define RTMIDI_ALSA_UMP 1
+#endif
+
 RTMIDI_NAMESPACE_START
 struct AlsaMidiData;
+class AlsaInputReactor;
+
+#define RTMIDI_CLASSNAME "AlsaSequencer"
+// Open a sequencer client or throw an exception.
+static void openAlsaSequencer( snd_seq_t *& seq, const std::string& name )
+{
+  int result = snd_seq_open( &seq, "default", SND_SEQ_OPEN_DUPLEX, SND_SEQ_NONBLOCK );
+  if ( result < 0 ) {
+    seq = 0;
+    switch ( result ) {
+    case -ENOENT: // /dev/snd/seq does not exist
+      // Error numbers are defined to be positive
+    case -EACCES: // /dev/snd/seq cannot be opened
+      throw RTMIDI_ERROR( snd_strerror( result ),
+                          Error::NO_DEVICES_FOUND );
+    default:
+      std::cerr << __FILE__ << ":" << __LINE__
+                << ": Got unhandled error number " << result << std::endl;
+      throw RTMIDI_ERROR( snd_strerror( result ),
+                          Error::DRIVER_ERROR );
+    }
+  }
+  snd_seq_set_client_name( seq, name.c_str( ) );
+}
+
+// Return the value of Midi::getMonotonicTime( ) at which the real
+// time of a running queue has been 0.
+static int64_t getAlsaQueueStartTime( snd_seq_t * seq, int queue_id )
+{
+  snd_seq_queue_status_t * status;
+  snd_seq_queue_status_alloca( &status );
+  int64_t before = Midi::getMonotonicTime( );
+  if ( snd_seq_get_queue_status( seq, queue_id, status ) < 0 )
+    return before;
+  int64_t after = Midi::getMonotonicTime( );
+  const snd_seq_real_time_t * time = snd_seq_queue_status_get_real_time( status );
+  return before + ( after - before ) / 2
+    - ( int64_t( time->tv_sec ) * 1000000000 + time->tv_nsec );
+}
+#undef RTMIDI_CLASSNAME
+
+/*! A sequencer client that is shared by all AlsaSequencer objects
+  with the same name ( see \ref Midi::setSharedClient ). The ports of
+  these objects are created on this client. The input events of all
+  ports are read by one AlsaInputReactor, which dispatches them by
+  their destination port. Output is serialised by the mutex.
+
+  The timestamping queue is shared, too. It is started by the first
+  input and runs until the client is closed, so all inputs report
+  times of the same queue.
+*/
+#define RTMIDI_CLASSNAME "AlsaSharedClient"
+struct AlsaSharedClient {
+  snd_seq_t * seq;
+  std::string name;
+  unsigned int references;
+  pthread_mutex_t mutex;
+  int queue_id;
+  int64_t queueStartTime;
+  // The reactor that reads the input and the number of inputs that
+  // are attached to it. Both are protected by its pool mutex.
+  AlsaInputReactor * reactor;
+  unsigned int readers;
+
+  static AlsaSharedClient * acquire( const std::string& name );
+  void release( );
+
+  // Return the shared queue, allocating it on first use.
+  int getQueue( ) {
+    scoped_lock<true> lock( mutex );
+    if ( queue_id < 0 ) {
+      queue_id = snd_seq_alloc_named_queue( seq, "Midi Queue" );
+      snd_seq_queue_tempo_t * qtempo;
+      snd_seq_queue_tempo_alloca( &qtempo );
+      snd_seq_queue_tempo_set_tempo( qtempo, 600000 );
+      snd_seq_queue_tempo_set_ppq( qtempo, 240 );
+      snd_seq_set_queue_tempo( seq, queue_id, qtempo );
+      snd_seq_drain_output( seq );
+    }
+    return queue_id;
+  }
+
+  // Start the shared queue, if it isn't running, yet, and return
+  // the time when it has been started.
+  int64_t startQueue( ) {
+    scoped_lock<true> lock( mutex );
+    if ( !queueStartTime ) {
+      snd_seq_start_queue( seq, queue_id, NULL );
+      snd_seq_drain_output( seq );
+      queueStartTime = getAlsaQueueStartTime( seq, queue_id );
+    }
+    return queueStartTime;
+  }
+
+protected:
+  AlsaSharedClient( const std::string& n )
+    : seq( 0 ), name( n ), references( 0 ),
+      queue_id( -1 ), queueStartTime( 0 ),
+      reactor( 0 ), readers( 0 ) {
+    pthread_mutex_init( &mutex, NULL );
+  }
+  ~AlsaSharedClient( ) {
+    pthread_mutex_destroy( &mutex );
+  }
+
+  static pthread_mutex_t registryMutex;
+  // The registry is never destroyed, as objects with static storage
+  // duration may release their client after static destructors ran.
+  static std::vector<AlsaSharedClient *> & registry( ) {
+    static std::vector<AlsaSharedClient *> * clients
+      = new std::vector<AlsaSharedClient *>( );
+    return *clients;
+  }
+};
+
+pthread_mutex_t AlsaSharedClient :: registryMutex = PTHREAD_MUTEX_INITIALIZER;
+
+AlsaSharedClient * AlsaSharedClient :: acquire( const std::string& name )
+{
+  scoped_lock<true> lock( registryMutex );
+  std::vector<AlsaSharedClient *> & clients = registry( );
+  for ( AlsaSharedClient * client : clients ) {
+    if ( client->name == name ) {
+      ++client->references;
+      return client;
+    }
+  }
+
+  AlsaSharedClient * client = new AlsaSharedClient( name );
+  try {
+    openAlsaSequencer( client->seq, name );
+  } catch ( ... ) {
+    delete client;
+    throw;
+  }
+  client->references = 1;
+  clients.push_back( client );
+  return client;
+}
+
+void AlsaSharedClient :: release( )
+{
+  scoped_lock<true> lock( registryMutex );
+  if ( --references ) return;
+
+  std::vector<AlsaSharedClient *> & clients = registry( );
+  clients.erase( std::remove( clients.begin( ), clients.end( ), this ),
+                 clients.end( ) );
+#ifndef AVOID_TIMESTAMPING
+  if ( queue_id >= 0 ) {
+    snd_seq_stop_queue( seq, queue_id, NULL );
+    snd_seq_drain_output( seq );
+    snd_seq_free_queue( seq, queue_id );
+  }
+#endif
+  snd_seq_close( seq );
+  delete this;
+}
+#undef RTMIDI_CLASSNAME
+
+// Orders sequencer addresses by client and port.
+struct AlsaAddressLess {
+  bool operator ( ) ( const snd_seq_addr_t& a, const snd_seq_addr_t& b ) const {
+    return a.client < b.client || ( a.client == b.client && a.port < b.port );
+  }
+};
+
+// Changes whenever \ref AlsaPortMonitor has received an announcement.
+// 0 means the monitor is not running, so no changes are noticed.
+static std::atomic<unsigned int> alsaPortGeneration( 0 );
+
+static void invalidateAlsaPortCache( )
+{
+  if ( !++alsaPortGeneration )
+    ++alsaPortGeneration;
+}
+
+// Start \ref AlsaPortMonitor, so that port information can be cached.
+static void startAlsaPortMonitor( );
+
+/*! The properties of a sequencer port that are needed to select it.
+  The ports of \ref AlsaPortMonitor are sorted by their address.
+*/
+struct AlsaPortInfo {
+  snd_seq_addr_t addr;
+  unsigned int capability; // SND_SEQ_PORT_CAP_*
+  unsigned int type; // SND_SEQ_PORT_TYPE_*
+
+  AlsaPortInfo( ) : capability( 0 ), type( 0 ) {
+    addr.client = 0;
+    addr.port = 0;
+  }
+  AlsaPortInfo( const snd_seq_port_info_t * pinfo )
+    : addr( *snd_seq_port_info_get_addr( pinfo ) ),
+      capability( snd_seq_port_info_get_capability( pinfo ) ),
+      type( snd_seq_port_info_get_type( pinfo ) ) {}
+
+  // Ports that are listed without PortDescriptor::UNLIMITED.
+  bool isMidi( ) const {
+    return type & ( SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_SYNTH );
+  }
+  // The capabilities as PortDescriptor::PortCapabilities.
+  int getCapabilities( ) const {
+    int retval = ( capability & ( SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ ) )?
+      PortDescriptor::INPUT : 0;
+    if ( capability & ( SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE ) )
+      retval |= PortDescriptor::OUTPUT;
+    return retval;
+  }
+  bool operator < ( const AlsaPortInfo& o ) const {
+    return AlsaAddressLess( ) ( addr, o.addr );
+  }
+};
 
 /*! An abstraction layer for the ALSA sequencer layer. It provides
   the following functionality:
@@ -2144,6 +2398,8 @@ struct AlsaMidiData;
   - optionallay avoid concurrent access to the ALSA sequencer,
   which is not thread proof. This feature is controlled by
   the parameter \ref locking.
+  - optionally use a client that is shared with other objects
+  ( see \ref AlsaSharedClient ).
 */
 
 #define RTMIDI_CLASSNAME "AlsaSequencer"
@@ -2151,7 +2407,7 @@ template <int locking=1>
 class AlsaSequencer {
 public:
   AlsaSequencer( )
-    : seq( 0 )
+    : seq( 0 ), shared( 0 ), cacheGeneration( 0 )
   {
     if ( locking ) {
       pthread_mutexattr_t attr;
@@ -2162,7 +2418,7 @@ public:
   }
 
   AlsaSequencer( const std::string& n )
-    : seq( 0 ), name( n )
+    : seq( 0 ), shared( 0 ), name( n ), cacheGeneration( 0 )
   {
     if ( locking ) {
       pthread_mutexattr_t attr;
@@ -2170,6 +2426,11 @@ public:
       pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_NORMAL );
       pthread_mutex_init( &mutex, &attr );
     }
+    if ( Midi::getSharedClient( ) ) {
+      shared = AlsaSharedClient::acquire( name );
+      seq = shared->seq;
+      return;
+    }
     init( );
     {
       scoped_lock<locking> lock( mutex );
@@ -2179,7 +2440,11 @@ public:
 
   ~AlsaSequencer( )
   {
-    if ( seq ) {
+    if ( shared ) {
+      shared->release( );
+      shared = 0;
+      seq = 0;
+    } else if ( seq ) {
       scoped_lock<locking> lock( mutex );
       snd_seq_close( seq );
       seq = 0;
@@ -2192,6 +2457,10 @@ public:
   int setName( const std::string& n ) {
     /* we don't want to rename the client after opening it. */
     name = n;
+    if ( shared ) {
+      scoped_lock<true> lock( shared->mutex );
+      return snd_seq_set_client_name( seq, name.c_str( ) );
+    }
     if ( seq ) {
       return snd_seq_set_client_name( seq, name.c_str( ) );
     }
@@ -2199,67 +2468,61 @@ public:
   }
 
   std::string GetPortName( int client, int port, int flags ) {
-    init( );
-    snd_seq_client_info_t * cinfo;
-    snd_seq_client_info_alloca( &cinfo );
-    {
-      scoped_lock<locking> lock ( mutex );
-      snd_seq_get_any_client_info( seq, client, cinfo );
-    }
+    CachedPort cached;
+    getCachedPort( client, port, cached );
 
-    snd_seq_port_info_t * pinfo;
-    snd_seq_port_info_alloca( &pinfo );
-    {
-      scoped_lock<locking> lock ( mutex );
-      snd_seq_get_any_port_info( seq, client, port, pinfo );
-    }
+    std::string address = std::to_string( client );
+    address += ':';
+    address += std::to_string( port );
 
+    std::string name;
     int naming = flags & PortDescriptor::NAMING_MASK;
-
-    std::ostringstream os;
     switch ( naming ) {
     case PortDescriptor::SESSION_PATH:
       if ( flags & PortDescriptor::INCLUDE_API )
-        os << "ALSA:";
-      os << client << ":" << port;
+        name += "ALSA:";
+      name += address;
       break;
     case PortDescriptor::STORAGE_PATH:
       if ( flags & PortDescriptor::INCLUDE_API )
-        os << "ALSA:";
-      os << snd_seq_client_info_get_name( cinfo );
-      os << ":";
-      os << snd_seq_port_info_get_name( pinfo );
-      if ( flags & PortDescriptor::UNIQUE_PORT_NAME )
-        os << ";" << client << ":" << port;
-      break;
-    case PortDescriptor::LONG_NAME:
-      os << snd_seq_client_info_get_name( cinfo );
+        name += "ALSA:";
+      name += cached.clientName;
+      name += ':';
+      name += cached.portName;
       if ( flags & PortDescriptor::UNIQUE_PORT_NAME ) {
-        os << " " << client;
+        name += ';';
+        name += address;
       }
-      os << ":";
+      break;
+    case PortDescriptor::LONG_NAME:
+      name += cached.clientName;
       if ( flags & PortDescriptor::UNIQUE_PORT_NAME ) {
-        os << port;
+        name += ' ';
+        name += address;
+      } else {
+        name += ':';
       }
-
-      os << " " << snd_seq_port_info_get_name( pinfo );
+      name += ' ';
+      name += cached.portName;
       if ( flags & PortDescriptor::INCLUDE_API )
-        os << " ( ALSA )";
+        name += " ( ALSA )";
       break;
     case PortDescriptor::SHORT_NAME:
     default:
-      os << snd_seq_client_info_get_name( cinfo );
+      name += cached.clientName;
       if ( flags & PortDescriptor::UNIQUE_PORT_NAME ) {
-        os << " ";
-        os << client;
+        name += ' ';
+        name += address;
+      } else {
+        name += ':';
+        name += std::to_string( port );
       }
-      os << ":" << port;
       if ( flags & PortDescriptor::INCLUDE_API )
-        os << " ( ALSA )";
+        name += " ( ALSA )";
 
       break;
     }
-    return os.str( );
+    return name;
   }
 
   void setPortName( const std::string& name, int port ) {
@@ -2284,19 +2547,43 @@ public:
   }
 
   int getPortCapabilities( int client, int port ) {
+    CachedPort cached;
+    getCachedPort( client, port, cached );
+    return cached.capabilities;
+  }
+
+  // Query a single port. Returns false if it doesn't exist.
+  bool getPortInfo( int client, int port, AlsaPortInfo& info ) {
     init( );
     snd_seq_port_info_t * pinfo;
     snd_seq_port_info_alloca( &pinfo );
     {
       scoped_lock<locking> lock ( mutex );
-      snd_seq_get_any_port_info( seq, client, port, pinfo );
+      if ( snd_seq_get_any_port_info( seq, client, port, pinfo ) < 0 )
+        return false;
+    }
+    info = AlsaPortInfo( pinfo );
+    return true;
+  }
+
+  // Append the ports of all clients except exclude to ports. They
+  // are sorted, as ALSA reports them in ascending order.
+  void getPorts( std::vector<AlsaPortInfo>& ports, int exclude = -1 ) {
+    snd_seq_client_info_t * cinfo;
+    snd_seq_port_info_t * pinfo;
+    snd_seq_client_info_alloca( &cinfo );
+    snd_seq_port_info_alloca( &pinfo );
+
+    snd_seq_client_info_set_client( cinfo, -1 );
+    while ( getNextClient( cinfo ) >= 0 ) {
+      int client = snd_seq_client_info_get_client( cinfo );
+      if ( client == exclude ) continue;
+      // Reset query info
+      snd_seq_port_info_set_client( pinfo, client );
+      snd_seq_port_info_set_port( pinfo, -1 );
+      while ( getNextPort( pinfo ) >= 0 )
+        ports.push_back( AlsaPortInfo( pinfo ) );
     }
-    unsigned int caps = snd_seq_port_info_get_capability( pinfo );
-    int retval = ( caps & ( SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ ) )?
-      PortDescriptor::INPUT : 0;
-    if ( caps & ( SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE ) )
-      retval |= PortDescriptor::OUTPUT;
-    return retval;
   }
 
   int getNextClient( snd_seq_client_info_t * cinfo ) {
@@ -2325,7 +2612,8 @@ public:
 
   snd_seq_port_subscribe_t * connectPorts( const snd_seq_addr_t& from,
                                            const snd_seq_addr_t& to,
-                                           bool real_time ) {
+                                           bool real_time,
+                                           int queue_id = -1 ) {
     init( );
     snd_seq_port_subscribe_t * subscription;
 
@@ -2340,6 +2628,8 @@ public:
       snd_seq_port_subscribe_set_time_update( subscription, 1 );
       snd_seq_port_subscribe_set_time_real( subscription, 1 );
     }
+    if ( queue_id >= 0 )
+      snd_seq_port_subscribe_set_queue( subscription, queue_id );
     {
       scoped_lock<locking> lock ( mutex );
       if ( snd_seq_subscribe_port( seq, subscription ) ) {
@@ -2366,6 +2656,66 @@ public:
     snd_seq_drain_output( seq );
   }
 
+  int createQueue( const char * name ) {
+    init( );
+    int queue_id;
+    {
+      scoped_lock<locking> lock( mutex );
+      queue_id = snd_seq_alloc_named_queue( seq, name );
+    }
+    if ( queue_id < 0 ) {
+      throw RTMIDI_ERROR1( gettext_noopt( "Could not allocate an ALSA queue: %s" ),
+                           Error::DRIVER_ERROR,
+                           snd_strerror( queue_id ) );
+    }
+    return queue_id;
+  }
+
+  void freeQueue( int queue_id ) {
+    init( );
+    scoped_lock<locking> lock( mutex );
+    snd_seq_free_queue( seq, queue_id );
+  }
+
+  // Resize the buffers and pools of the client. Sizes of 0 are left
+  // alone. Resizing a buffer discards its contents, so the caller
+  // must keep other threads from using it.
+  void setBufferSizes( const BufferSizes& sizes ) {
+    init( );
+    scoped_lock<locking> lock( mutex );
+    int result = 0;
+    if ( sizes.outputBuffer ) {
+      snd_seq_drain_output( seq );
+      result = snd_seq_set_output_buffer_size( seq, sizes.outputBuffer );
+    }
+    if ( sizes.inputBuffer && result >= 0 )
+      result = snd_seq_set_input_buffer_size( seq, sizes.inputBuffer );
+    if ( sizes.outputPool && result >= 0 )
+      result = snd_seq_set_client_pool_output( seq, sizes.outputPool );
+    if ( sizes.inputPool && result >= 0 )
+      result = snd_seq_set_client_pool_input( seq, sizes.inputPool );
+    if ( result < 0 ) {
+      throw RTMIDI_ERROR1( gettext_noopt( "Could not set the ALSA buffer sizes: %s" ),
+                           Error::DRIVER_ERROR,
+                           snd_strerror( result ) );
+    }
+  }
+
+#ifdef RTMIDI_ALSA_UMP
+  // Select the event format of the client. Kernels before Linux 6.5
+  // reject UMP clients.
+  void setMidiVersion( int version ) {
+    init( );
+    scoped_lock<locking> lock( mutex );
+    int result = snd_seq_set_client_midi_version( seq, version );
+    if ( result < 0 ) {
+      throw RTMIDI_ERROR1( gettext_noopt( "Could not select the MIDI version of the ALSA client: %s" ),
+                           Error::DRIVER_ERROR,
+                           snd_strerror( result ) );
+    }
+  }
+#endif
+
   /*! Use AlsaSequencer like a C pointer.
     \note This function breaks the design to control thread safety
     by the selection of the \ref locking parameter to the class.
@@ -2376,11 +2726,71 @@ public:
   {
     return seq;
   }
+  // Return the mutex that serialises output, or 0 if the client
+  // is not shared.
+  pthread_mutex_t * outputMutex( ) {
+    return shared ? &shared->mutex : 0;
+  }
 public:
   pthread_mutex_t mutex;
   snd_seq_t * seq;
+  AlsaSharedClient * shared;
   std::string name;
 
+  // What we need to know to describe a port.
+  struct CachedPort {
+    std::string clientName;
+    std::string portName;
+    int capabilities;
+  };
+  // The ports that have been looked up since alsaPortGeneration
+  // changed for the last time. Protected by the mutex.
+  typedef std::map<snd_seq_addr_t, CachedPort, AlsaAddressLess> PortCache;
+  PortCache cache;
+  unsigned int cacheGeneration;
+
+  // Look up a port. The information is cached as long as the port
+  // monitor is running, which tells us when it gets outdated. The
+  // first lookup starts the monitor.
+  void getCachedPort( int client, int port, CachedPort& cached ) {
+    init( );
+    snd_seq_addr_t addr;
+    addr.client = client;
+    addr.port = port;
+    if ( !alsaPortGeneration )
+      startAlsaPortMonitor( );
+    unsigned int generation = alsaPortGeneration;
+    if ( generation ) {
+      scoped_lock<locking> lock ( mutex );
+      if ( generation != cacheGeneration ) {
+        cache.clear( );
+        cacheGeneration = generation;
+      }
+      typename PortCache::const_iterator i = cache.find( addr );
+      if ( i != cache.end( ) ) {
+        cached = i->second;
+        return;
+      }
+    }
+
+    snd_seq_client_info_t * cinfo;
+    snd_seq_port_info_t * pinfo;
+    snd_seq_client_info_alloca( &cinfo );
+    snd_seq_port_info_alloca( &pinfo );
+    {
+      scoped_lock<locking> lock ( mutex );
+      snd_seq_get_any_client_info( seq, client, cinfo );
+      snd_seq_get_any_port_info( seq, client, port, pinfo );
+      cached.clientName = snd_seq_client_info_get_name( cinfo );
+      cached.portName = snd_seq_port_info_get_name( pinfo );
+      cached.capabilities = AlsaPortInfo( pinfo ).getCapabilities( );
+      // If another lookup has seen a newer announcement, meanwhile,
+      // our answer may be older than that.
+      if ( generation && generation == cacheGeneration )
+        cache[addr] = cached;
+    }
+  }
+
 
   snd_seq_client_info_t * GetClient( int id ) {
     init( );
@@ -2400,24 +2810,7 @@ public:
     if ( s ) return;
     {
       scoped_lock<locking> lock( mutex );
-      int result = snd_seq_open( &s, "default", SND_SEQ_OPEN_DUPLEX, SND_SEQ_NONBLOCK );
-      if ( result < 0 ) {
-        switch ( result ) {
-        case -ENOENT: // /dev/snd/seq does not exist
-          // Error numbers are defined to be positive
-        case -EACCES: // /dev/snd/seq cannot be opened
-          throw RTMIDI_ERROR( snd_strerror( result ),
-                              Error::NO_DEVICES_FOUND );
-          return;
-        default:
-          std::cerr << __FILE__ << ":" << __LINE__
-                    << ": Got unhandled error number " << result << std::endl;
-          throw RTMIDI_ERROR( snd_strerror( result ),
-                              Error::DRIVER_ERROR );
-          return;
-        }
-      }
-      snd_seq_set_client_name( seq, name.c_str( ) );
+      openAlsaSequencer( s, name );
     }
   }
 };
@@ -2463,10 +2856,9 @@ struct AlsaPortDescriptor
     return clientName;
   }
 
-  int getCapabilities( ) const {
-    if ( !client ) return 0;
-    return seq.getPortCapabilities( client, port );
-  }
+  int getCapabilities( ) const;
+
+  Route * createRoute( const PortDescriptor& destination, int flags ) const;
 
   virtual bool operator == ( const PortDescriptor& o ) {
     const AlsaPortDescriptor * desc = dynamic_cast<const AlsaPortDescriptor*>( &o );
@@ -2479,71 +2871,494 @@ public:
 };
 
 LockingAlsaSequencer AlsaPortDescriptor :: seq;
+#undef RTMIDI_CLASSNAME
 
+/*! Keeps a list of all sequencer ports up to date ( see \ref
+  Midi::setPortChangeCallback ).
 
+  The monitor opens its own client and subscribes it to the announce
+  port of the system client. Its thread applies the announcements to
+  the port list and passes them on to the registered callbacks. While
+  the monitor is running, AlsaPortDescriptor reads the port list and
+  the capabilities of the ports from memory.
 
-PortList AlsaPortDescriptor :: getPortList( int capabilities, const std::string& clientName )
+  Each announcement changes alsaPortGeneration, which invalidates
+  the port information that AlsaSequencer objects have cached.
+
+  The monitor is started by the first callback or the first lookup
+  of a port name. Like the input reactors it is never stopped, so the
+  port list stays up to date for later enumerations.
+*/
+#define RTMIDI_CLASSNAME "AlsaPortMonitor"
+class AlsaPortMonitor {
+public:
+  // Register a callback of owner. Throws if the monitor cannot be started.
+  static void attach( const void * owner,
+                      PortChangeInterface * callback,
+                      const std::string& clientName );
+  // Unregister the callback of owner. Waits until it is not called anymore.
+  static void detach( const void * owner );
+  // Copy the port list. Returns false if the monitor is not running.
+  static bool getPorts( std::vector<AlsaPortInfo>& ports );
+  // Look up a port. Returns false if the monitor is not running or
+  // does not know the port.
+  static bool getPort( int client, int port, AlsaPortInfo& info );
+  // Start the monitor without a callback. A failure is not reported
+  // and not retried, as the port information can still be read
+  // directly.
+  static void startCache( );
+protected:
+  struct Listener {
+    const void * owner;
+    PortChangeInterface * callback;
+    std::string clientName;
+  };
+  struct Change {
+    PortChange::Type type;
+    snd_seq_addr_t addr;
+  };
+
+  AlsaPortMonitor( );
+  static AlsaPortMonitor& instance( );
+  void start( );
+  void handleEvent( const snd_seq_event_t * ev );
+  void updatePort( const AlsaPortInfo * old, const AlsaPortInfo * now );
+  void rescan( );
+  void notify( );
+  static void * monitorHandler( void * ptr ) throw( );
+
+  NonLockingAlsaSequencer seq;
+  pthread_t thread;
+  // Protects the port list. It is held only briefly.
+  pthread_mutex_t mutex;
+  std::atomic<bool> running;
+  bool failed; // startCache( ) could not start the monitor
+  std::vector<AlsaPortInfo> ports;
+  // Protects the listeners. It is held while the callbacks are
+  // called and recursive, so that callbacks can replace themselves.
+  pthread_mutex_t callbackMutex;
+  std::vector<Listener> listeners;
+  // Changes that have not been passed on to the listeners, yet.
+  std::vector<Change> changes;
+};
+
+AlsaPortMonitor :: AlsaPortMonitor( )
+  : running( false ),
+    failed( false )
 {
-  PortList list;
-  snd_seq_client_info_t * cinfo;
-  snd_seq_port_info_t * pinfo;
-  int client;
-  snd_seq_client_info_alloca( &cinfo );
-  snd_seq_port_info_alloca( &pinfo );
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init( &attr );
+  pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+  pthread_mutex_init( &callbackMutex, &attr );
+  pthread_mutexattr_destroy( &attr );
+  pthread_mutex_init( &mutex, NULL );
+}
 
-  snd_seq_client_info_set_client( cinfo, -1 );
-  while ( seq.getNextClient( cinfo ) >= 0 ) {
-    client = snd_seq_client_info_get_client( cinfo );
-    // ignore default device ( it is included in the following results again )
-    if ( client == 0 ) continue;
-    // Reset query info
-    snd_seq_port_info_set_client( pinfo, client );
-    snd_seq_port_info_set_port( pinfo, -1 );
-    while ( seq.getNextPort( pinfo ) >= 0 ) {
-      unsigned int atyp = snd_seq_port_info_get_type( pinfo );
-      // otherwise we get ports without any
-      if ( !( capabilities & UNLIMITED ) &&
-           !( atyp & SND_SEQ_PORT_TYPE_MIDI_GENERIC ) &&
-           !( atyp & SND_SEQ_PORT_TYPE_SYNTH )
-           ) continue;
-      unsigned int caps = snd_seq_port_info_get_capability( pinfo );
-      if ( capabilities & INPUT ) {
-        /* we need both READ and SUBS_READ */
-        if ( ( caps & ( SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ ) )
-             != ( SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ ) )
-          continue;
-      }
-      if ( capabilities & OUTPUT ) {
-        /* we need both WRITE and SUBS_WRITE */
-        if ( ( caps & ( SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE ) )
-             != ( SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE ) )
-          continue;
-      }
-      list.push_back( Pointer<PortDescriptor>(
-                                              new AlsaPortDescriptor( client, snd_seq_port_info_get_port( pinfo ), clientName ) ) );
+// The monitor is never destroyed, as its thread may still run while
+// static destructors are called.
+AlsaPortMonitor& AlsaPortMonitor :: instance( )
+{
+  static AlsaPortMonitor * monitor = new AlsaPortMonitor( );
+  return *monitor;
+}
+
+void AlsaPortMonitor :: attach( const void * owner,
+                                PortChangeInterface * callback,
+                                const std::string& clientName )
+{
+  AlsaPortMonitor& monitor = instance( );
+  scoped_lock<true> lock( monitor.callbackMutex );
+  if ( !monitor.running )
+    monitor.start( );
+  Listener listener = { owner, callback, clientName };
+  monitor.listeners.push_back( listener );
+}
+
+void AlsaPortMonitor :: detach( const void * owner )
+{
+  AlsaPortMonitor& monitor = instance( );
+  scoped_lock<true> lock( monitor.callbackMutex );
+  for ( size_t i = 0; i < monitor.listeners.size( ); i++ ) {
+    if ( monitor.listeners[i].owner == owner ) {
+      monitor.listeners.erase( monitor.listeners.begin( ) + i );
+      return;
     }
   }
-  return list;
 }
-#undef RTMIDI_CLASSNAME
 
+bool AlsaPortMonitor :: getPorts( std::vector<AlsaPortInfo>& ports )
+{
+  AlsaPortMonitor& monitor = instance( );
+  if ( !monitor.running ) return false;
+  scoped_lock<true> lock( monitor.mutex );
+  ports = monitor.ports;
+  return true;
+}
 
-/*! A structure to hold variables related to the ALSA API
-  implementation.
+bool AlsaPortMonitor :: getPort( int client, int port, AlsaPortInfo& info )
+{
+  AlsaPortMonitor& monitor = instance( );
+  if ( !monitor.running ) return false;
+  AlsaPortInfo key;
+  key.addr.client = client;
+  key.addr.port = port;
+  scoped_lock<true> lock( monitor.mutex );
+  std::vector<AlsaPortInfo>::const_iterator i
+    = std::lower_bound( monitor.ports.begin( ), monitor.ports.end( ), key );
+  if ( i == monitor.ports.end( ) || key < *i )
+    return false;
+  info = *i;
+  return true;
+}
 
-  \note After all sequencer handling is covered by the \ref
-  AlsaSequencer class, we should make seq to be a pointer in order
-  to allow a common client implementation.
-*/
-#define RTMIDI_CLASSNAME "AlsaMidiData"
+void AlsaPortMonitor :: startCache( )
+{
+  AlsaPortMonitor& monitor = instance( );
+  if ( monitor.running ) return;
+  scoped_lock<true> lock( monitor.callbackMutex );
+  if ( monitor.running || monitor.failed ) return;
+  try {
+    monitor.start( );
+  } catch ( Error& e ) {
+    monitor.failed = true;
+  }
+}
 
-struct AlsaMidiData: public AlsaPortDescriptor {
-  /*
-    AlsaMidiData( )
-    : seq( )
-    {
-    init( );
-    }
+// Called with callbackMutex held.
+void AlsaPortMonitor :: start( )
+{
+  seq.setName( "RtMidi Port Monitor" );
+  seq.init( );
+  int port = snd_seq_create_simple_port( seq, "Announcements",
+                                         SND_SEQ_PORT_CAP_WRITE
+                                         | SND_SEQ_PORT_CAP_NO_EXPORT,
+                                         SND_SEQ_PORT_TYPE_APPLICATION );
+  if ( port < 0
+       || snd_seq_connect_from( seq, port, SND_SEQ_CLIENT_SYSTEM,
+                                SND_SEQ_PORT_SYSTEM_ANNOUNCE ) < 0 ) {
+    snd_seq_close( seq.seq );
+    seq.seq = 0;
+    throw RTMIDI_ERROR( gettext_noopt( "Could not subscribe to the ALSA announcements." ),
+                        Error::DRIVER_ERROR );
+  }
+
+  // We are subscribed before the list is read, so no change can be
+  // missed. Announcements of ports that are already known are
+  // harmless.
+  std::vector<AlsaPortInfo> current;
+  seq.getPorts( current, snd_seq_client_id( seq ) );
+  {
+    scoped_lock<true> lock( mutex );
+    ports.swap( current );
+  }
+
+  pthread_attr_t attr;
+  pthread_attr_init( &attr );
+  pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+  pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
+  int err = pthread_create( &thread, &attr, monitorHandler, this );
+  pthread_attr_destroy( &attr );
+  if ( err ) {
+    snd_seq_close( seq.seq );
+    seq.seq = 0;
+    throw RTMIDI_ERROR( gettext_noopt( "Error creating the ALSA port monitor thread." ),
+                        Error::THREAD_ERROR );
+  }
+  running = true;
+  // From now on, port names and capabilities can be cached.
+  invalidateAlsaPortCache( );
+}
+
+// Record the change of a port from old to now. Either may be 0 if
+// the port did not or does not exist. Ports that are not listed by
+// default appear to the callbacks as if they did not exist.
+void AlsaPortMonitor :: updatePort( const AlsaPortInfo * old,
+                                    const AlsaPortInfo * now )
+{
+  bool wasListed = old && old->isMidi( );
+  bool isListed = now && now->isMidi( );
+  if ( !wasListed && !isListed ) return;
+
+  Change change;
+  change.addr = now ? now->addr : old->addr;
+  if ( !wasListed )
+    change.type = PortChange::ADDED;
+  else if ( !isListed )
+    change.type = PortChange::REMOVED;
+  else
+    change.type = PortChange::CHANGED;
+  changes.push_back( change );
+}
+
+// Apply an announcement to the port list.
+void AlsaPortMonitor :: handleEvent( const snd_seq_event_t * ev )
+{
+  AlsaPortInfo key;
+  key.addr = ev->data.addr;
+  switch ( ev->type ) {
+  case SND_SEQ_EVENT_PORT_START:
+  case SND_SEQ_EVENT_PORT_CHANGE: {
+    AlsaPortInfo now;
+    bool exists = seq.getPortInfo( key.addr.client, key.addr.port, now );
+    scoped_lock<true> lock( mutex );
+    std::vector<AlsaPortInfo>::iterator i
+      = std::lower_bound( ports.begin( ), ports.end( ), key );
+    bool known = i != ports.end( ) && !( key < *i );
+    updatePort( known ? &*i : 0, exists ? &now : 0 );
+    if ( known && exists )
+      *i = now;
+    else if ( known )
+      ports.erase( i );
+    else if ( exists )
+      ports.insert( i, now );
+    break;
+  }
+  case SND_SEQ_EVENT_PORT_EXIT: {
+    scoped_lock<true> lock( mutex );
+    std::vector<AlsaPortInfo>::iterator i
+      = std::lower_bound( ports.begin( ), ports.end( ), key );
+    if ( i != ports.end( ) && !( key < *i ) ) {
+      updatePort( &*i, 0 );
+      ports.erase( i );
+    }
+    break;
+  }
+  case SND_SEQ_EVENT_CLIENT_CHANGE:
+  case SND_SEQ_EVENT_CLIENT_EXIT: {
+    // A renamed client renames all of its ports.
+    bool exit = ev->type == SND_SEQ_EVENT_CLIENT_EXIT;
+    key.addr.port = 0;
+    scoped_lock<true> lock( mutex );
+    std::vector<AlsaPortInfo>::iterator i
+      = std::lower_bound( ports.begin( ), ports.end( ), key );
+    std::vector<AlsaPortInfo>::iterator end = i;
+    for ( ; end != ports.end( ) && end->addr.client == key.addr.client; ++end )
+      updatePort( &*end, exit ? 0 : &*end );
+    if ( exit )
+      ports.erase( i, end );
+    break;
+  }
+  default:
+    return;
+  }
+  invalidateAlsaPortCache( );
+}
+
+// Read the port list again and record the differences. This is
+// necessary if announcements have been lost.
+void AlsaPortMonitor :: rescan( )
+{
+  std::vector<AlsaPortInfo> current;
+  seq.getPorts( current, snd_seq_client_id( seq ) );
+
+  scoped_lock<true> lock( mutex );
+  std::vector<AlsaPortInfo>::const_iterator old = ports.begin( );
+  std::vector<AlsaPortInfo>::const_iterator now = current.begin( );
+  while ( old != ports.end( ) || now != current.end( ) ) {
+    if ( now == current.end( ) || ( old != ports.end( ) && *old < *now ) ) {
+      updatePort( &*old, 0 );
+      ++old;
+    } else if ( old == ports.end( ) || *now < *old ) {
+      updatePort( 0, &*now );
+      ++now;
+    } else {
+      // Renamed ports cannot be detected here.
+      if ( old->capability != now->capability || old->type != now->type )
+        updatePort( &*old, &*now );
+      ++old;
+      ++now;
+    }
+  }
+  ports.swap( current );
+  invalidateAlsaPortCache( );
+}
+
+// Pass the recorded changes on to the callbacks.
+void AlsaPortMonitor :: notify( )
+{
+  if ( changes.empty( ) ) return;
+  scoped_lock<true> lock( callbackMutex );
+  for ( const Change& change : changes ) {
+    // A callback may remove or add listeners.
+    std::vector<Listener> current = listeners;
+    for ( const Listener& listener : current ) {
+      bool attached = false;
+      for ( const Listener& l : listeners )
+        attached = attached || ( l.owner == listener.owner
+                                 && l.callback == listener.callback );
+      if ( !attached ) continue;
+
+      PortChange portChange;
+      portChange.type = change.type;
+      portChange.port = Pointer<PortDescriptor>(
+                                                new AlsaPortDescriptor( change.addr.client,
+                                                                        change.addr.port,
+                                                                        listener.clientName ) );
+      listener.callback->rtmidi_port_changed( portChange );
+    }
+  }
+  changes.clear( );
+}
+
+// static function:
+void * AlsaPortMonitor :: monitorHandler( void * ptr ) throw( )
+{
+  AlsaPortMonitor * monitor = static_cast<AlsaPortMonitor *> ( ptr );
+  snd_seq_t * seq = monitor->seq;
+
+  int poll_fd_count = snd_seq_poll_descriptors_count( seq, POLLIN );
+  struct pollfd * poll_fds
+    = (struct pollfd*) alloca( poll_fd_count * sizeof( struct pollfd ) );
+  snd_seq_poll_descriptors( seq, poll_fds, poll_fd_count, POLLIN );
+
+  for ( ;; ) {
+    // See MidiInAlsa::handleEvents( ).
+    snd_seq_event_t * ev;
+    int result;
+    while ( ( result = snd_seq_event_input( seq, &ev ) ) != -EAGAIN ) {
+      if ( result == -ENOSPC ) {
+        monitor->rescan( );
+        continue;
+      }
+      if ( result < 0 ) break;
+      monitor->handleEvent( ev );
+      snd_seq_free_event( ev );
+    }
+    monitor->notify( );
+
+    poll( poll_fds, poll_fd_count, -1 );
+  }
+  return 0;
+}
+#undef RTMIDI_CLASSNAME
+
+static void startAlsaPortMonitor( )
+{
+  AlsaPortMonitor::startCache( );
+}
+
+/*! A subscription between two foreign ports. It is made by the
+  sequencer of the port descriptors, which lives as long as the
+  application. A timestamping queue belongs to the route and is freed
+  with it.
+*/
+#define RTMIDI_CLASSNAME "AlsaRoute"
+class AlsaRoute : public Route {
+public:
+  AlsaRoute( const snd_seq_addr_t& from,
+             const snd_seq_addr_t& to,
+             int flags );
+  ~AlsaRoute( ) { disconnect( ); }
+  void disconnect( );
+protected:
+  snd_seq_port_subscribe_t * subscription;
+  int queue_id;
+};
+
+AlsaRoute :: AlsaRoute( const snd_seq_addr_t& from,
+                        const snd_seq_addr_t& to,
+                        int flags )
+  : subscription( 0 ),
+    queue_id( -1 )
+{
+  if ( flags & TIMESTAMP ) {
+    queue_id = AlsaPortDescriptor::seq.createQueue( "RtMidi Route" );
+    AlsaPortDescriptor::seq.startQueue( queue_id );
+  }
+  try {
+    subscription = AlsaPortDescriptor::seq.connectPorts( from, to,
+                                                         flags & TIMESTAMP,
+                                                         queue_id );
+  } catch ( Error& e ) {
+    disconnect( );
+    throw;
+  }
+}
+
+void AlsaRoute :: disconnect( )
+{
+  if ( subscription ) {
+    AlsaPortDescriptor::seq.closePort( subscription );
+    snd_seq_port_subscribe_free( subscription );
+    subscription = 0;
+  }
+  if ( queue_id >= 0 ) {
+    AlsaPortDescriptor::seq.freeQueue( queue_id );
+    queue_id = -1;
+  }
+}
+#undef RTMIDI_CLASSNAME
+
+#define RTMIDI_CLASSNAME "AlsaPortDescriptor"
+Route * AlsaPortDescriptor :: createRoute( const PortDescriptor& destination,
+                                          int flags ) const
+{
+  const AlsaPortDescriptor * to = dynamic_cast<const AlsaPortDescriptor *>( &destination );
+  if ( !to ) {
+    throw RTMIDI_ERROR( gettext_noopt( "ALSA cannot route messages to a non-ALSA MIDI port." ),
+                        Error::INVALID_DEVICE );
+  }
+  return new AlsaRoute( *this, *to, flags );
+}
+
+int AlsaPortDescriptor :: getCapabilities( ) const
+{
+  if ( !client ) return 0;
+  AlsaPortInfo info;
+  if ( AlsaPortMonitor::getPort( client, port, info ) )
+    return info.getCapabilities( );
+  return seq.getPortCapabilities( client, port );
+}
+
+PortList AlsaPortDescriptor :: getPortList( int capabilities, const std::string& clientName )
+{
+  PortList list;
+  std::vector<AlsaPortInfo> ports;
+  if ( !AlsaPortMonitor::getPorts( ports ) )
+    seq.getPorts( ports );
+
+  for ( const AlsaPortInfo& info : ports ) {
+    // ignore default device ( it is included in the following results again )
+    if ( info.addr.client == 0 ) continue;
+    // otherwise we get ports without any
+    if ( !( capabilities & UNLIMITED ) && !info.isMidi( ) ) continue;
+    unsigned int caps = info.capability;
+    if ( capabilities & INPUT ) {
+      /* we need both READ and SUBS_READ */
+      if ( ( caps & ( SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ ) )
+           != ( SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ ) )
+        continue;
+    }
+    if ( capabilities & OUTPUT ) {
+      /* we need both WRITE and SUBS_WRITE */
+      if ( ( caps & ( SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE ) )
+           != ( SND_SEQ_PORT_CAP_WRITE|SND_SEQ_PORT_CAP_SUBS_WRITE ) )
+        continue;
+    }
+    list.push_back( Pointer<PortDescriptor>(
+                                            new AlsaPortDescriptor( info.addr.client, info.addr.port, clientName ) ) );
+  }
+  return list;
+}
+#undef RTMIDI_CLASSNAME
+
+
+/*! A structure to hold variables related to the ALSA API
+  implementation.
+
+  \note After all sequencer handling is covered by the \ref
+  AlsaSequencer class, we should make seq to be a pointer in order
+  to allow a common client implementation.
+*/
+#define RTMIDI_CLASSNAME "AlsaMidiData"
+
+struct AlsaMidiData: public AlsaPortDescriptor {
+  /*
+    AlsaMidiData( )
+    : seq( )
+    {
+    init( );
+    }
   */
   AlsaMidiData( const std::string& clientName )
     : AlsaPortDescriptor( clientName ),
@@ -2553,8 +3368,9 @@ struct AlsaMidiData: public AlsaPortDescriptor {
   }
   ~AlsaMidiData( )
   {
+    watchPorts( 0 );
     try {
-      if ( local.client && local.port )
+      if ( local.client )
         deletePort( );
     } catch ( const Error& e ) {
       // we don't have access to the error handler
@@ -2562,7 +3378,7 @@ struct AlsaMidiData: public AlsaPortDescriptor {
     }
   }
   void init ( ) {
-    local.port = 0;
+    local.port = -1;
     local.client = 0;
     port = -1;
     subscription = 0;
@@ -2570,12 +3386,13 @@ struct AlsaMidiData: public AlsaPortDescriptor {
     dummy_thread_id = pthread_self( );
     thread = dummy_thread_id;
     queue_id = -1;
-    trigger_fds[0] = -1;
-    trigger_fds[1] = -1;
-    lastTime.tv_sec = 0;
-    lastTime.tv_nsec = 0;
+    trigger_fd = -1;
+    lastTime = 0;
+    queueStartTime = 0;
+    portChangeCallback = 0;
+    protocol = MIDI_BYTE_STREAM;
   }
-  snd_seq_addr_t local; /*!< Our port and client id. If client = 0 ( default ) this means we didn't aquire a port so far. */
+  snd_seq_addr_t local; /*!< Our port and client id. If client = 0 ( default ) this means we didn't aquire a port so far. Port 0 is a valid port, e.g. the first port of a shared client. */
   NonLockingAlsaSequencer seq;
   //  unsigned int portNum;
   snd_seq_port_subscribe_t * subscription;
@@ -2583,9 +3400,54 @@ struct AlsaMidiData: public AlsaPortDescriptor {
   std::array<unsigned char, 32> buffer;
   pthread_t thread;
   pthread_t dummy_thread_id;
-  snd_seq_real_time_t lastTime;
+  int64_t lastTime; // absolute time of the previous input message
+  int64_t queueStartTime; // Midi::getMonotonicTime( ) when the queue was started
   int queue_id; // an input queue is needed to get timestamped events
-  int trigger_fds[2];
+  int trigger_fd; // eventfd that wakes the input thread
+  PortChangeInterface * portChangeCallback;
+  MidiProtocol protocol; // format of the messages ( see Midi::setProtocol )
+
+  // Select the message format. Throws if it cannot be changed.
+  void setProtocol( MidiProtocol p ) {
+    if ( p == protocol ) return;
+#ifdef RTMIDI_ALSA_UMP
+    if ( seq.shared )
+      throw RTMIDI_ERROR( gettext_noopt( "The protocol of a shared ALSA client cannot be changed." ),
+                          Error::INVALID_USE );
+    // Events in the input buffer would be misinterpreted.
+    if ( local.client )
+      throw RTMIDI_ERROR( gettext_noopt( "The protocol must be selected before a port is opened." ),
+                          Error::INVALID_USE );
+    switch ( p ) {
+    case UMP_MIDI_1_0:
+      seq.setMidiVersion( SND_SEQ_CLIENT_UMP_MIDI_1_0 );
+      break;
+    case UMP_MIDI_2_0:
+      seq.setMidiVersion( SND_SEQ_CLIENT_UMP_MIDI_2_0 );
+      break;
+    default:
+      seq.setMidiVersion( SND_SEQ_CLIENT_LEGACY_MIDI );
+    }
+    protocol = p;
+#else
+    throw RTMIDI_ERROR( gettext_noopt( "This ALSA version does not support Universal MIDI Packets." ),
+                        Error::WARNING );
+#endif
+  }
+
+  // Replace the port change callback. Throws if the port monitor
+  // cannot be started.
+  void watchPorts( PortChangeInterface * callback ) {
+    if ( portChangeCallback ) {
+      AlsaPortMonitor::detach( this );
+      portChangeCallback->delete_me( );
+      portChangeCallback = 0;
+    }
+    if ( callback ) {
+      AlsaPortMonitor::attach( this, callback, getClientName( ) );
+      portChangeCallback = callback;
+    }
+  }
 
   void setRemote( const AlsaPortDescriptor * remote ) {
     port = remote->port;
@@ -2648,7 +3510,7 @@ struct AlsaMidiData: public AlsaPortDescriptor {
   void deletePort( ) {
     seq.deletePort( local.port );
     local.client = 0;
-    local.port = 0;
+    local.port = -1;
   }
 
   void closePort( ) {
@@ -2665,8 +3527,6 @@ struct AlsaMidiData: public AlsaPortDescriptor {
     seq.setName( name );
   }
 
-  bool startQueue( void * userdata );
-
   long alsa2Midi( const snd_seq_event_t * event,
                   unsigned char * buffer,
                   long size ) {
@@ -2679,6 +3539,192 @@ struct AlsaMidiData: public AlsaPortDescriptor {
 #undef RTMIDI_CLASSNAME
 
 
+/*! Direct translation between short MIDI messages and ALSA sequencer
+  events.
+
+  snd_midi_event_t parses its input byte by byte through a state
+  machine. For complete channel voice, system common and real time
+  messages this is unnecessary: each of them corresponds to exactly
+  one event type with a fixed field layout. Everything else ( SysEx,
+  14 bit controllers, ( N )RPN events, streams of several messages ) is
+  left to snd_midi_event_t. The output keeps track of the running
+  status itself, as the parser does not see the messages that are
+  translated here.
+*/
+#define RTMIDI_CLASSNAME "AlsaEventCodec"
+class AlsaEventCodec {
+public:
+  //! Fill ev from a complete short message.
+  /*! Only the type and data fields of ev are written.
+    \return false if the message must be passed to snd_midi_event_encode( ).
+  */
+  static bool encode( const unsigned char * message, size_t size,
+                      snd_seq_event_t * ev ) {
+    if ( size == 0 || message[0] < 0x80 )
+      return false;
+    const Entry& entry = tables( ).byStatus[statusIndex( message[0] )];
+    if ( size != layoutSize[entry.layout] )
+      return false;
+    for ( size_t i = 1; i < size; i++ )
+      if ( message[i] & 0x80 )
+        return false;
+
+    unsigned char channel = message[0] & 0x0f;
+    ev->type = entry.type;
+    snd_seq_ev_set_fixed( ev );
+    switch ( entry.layout ) {
+    case NOTE:
+      ev->data.note.channel = channel;
+      ev->data.note.note = message[1];
+      ev->data.note.velocity = message[2];
+      break;
+    case CONTROL:
+      ev->data.control.channel = channel;
+      ev->data.control.param = message[1];
+      ev->data.control.value = message[2];
+      break;
+    case VALUE:
+      ev->data.control.channel = channel;
+      ev->data.control.value = message[1];
+      break;
+    case VALUE14:
+      ev->data.control.channel = channel;
+      ev->data.control.value = message[1] | ( message[2] << 7 );
+      break;
+    case PITCHBEND:
+      ev->data.control.channel = channel;
+      ev->data.control.value = ( message[1] | ( message[2] << 7 ) ) - 8192;
+      break;
+    case STATUS:
+      break;
+    default:
+      return false;
+    }
+    return true;
+  }
+
+  //! Write the MIDI bytes of ev to message, which holds 3 bytes.
+  /*! \return the number of bytes or 0 if the event must be passed to
+    snd_midi_event_decode( ).
+  */
+  static size_t decode( const snd_seq_event_t * ev, unsigned char * message ) {
+    if ( ev->type >= typeCount )
+      return 0;
+    const Entry& entry = tables( ).byType[ev->type];
+    int value;
+    message[0] = entry.status;
+    switch ( entry.layout ) {
+    case NOTE:
+      message[0] |= ev->data.note.channel & 0x0f;
+      message[1] = ev->data.note.note & 0x7f;
+      message[2] = ev->data.note.velocity & 0x7f;
+      break;
+    case CONTROL:
+      message[0] |= ev->data.control.channel & 0x0f;
+      message[1] = ev->data.control.param & 0x7f;
+      message[2] = ev->data.control.value & 0x7f;
+      break;
+    case VALUE:
+      if ( entry.status < 0xf0 )
+        message[0] |= ev->data.control.channel & 0x0f;
+      message[1] = ev->data.control.value & 0x7f;
+      break;
+    case VALUE14:
+    case PITCHBEND:
+      value = ev->data.control.value;
+      if ( entry.layout == PITCHBEND ) {
+        message[0] |= ev->data.control.channel & 0x0f;
+        value += 8192;
+      }
+      message[1] = value & 0x7f;
+      message[2] = ( value >> 7 ) & 0x7f;
+      break;
+    case STATUS:
+      break;
+    default:
+      return 0;
+    }
+    return layoutSize[entry.layout];
+  }
+
+protected:
+  enum Layout {
+    UNSUPPORTED, // use snd_midi_event_t
+    NOTE,        // status, note, velocity
+    CONTROL,     // status, parameter, value
+    VALUE,       // status, value
+    VALUE14,     // status, 14 bit value, LSB first
+    PITCHBEND,   // status, 14 bit value - 8192, LSB first
+    STATUS       // status byte only
+  };
+  struct Entry {
+    unsigned char status;
+    unsigned char type;
+    unsigned char layout;
+  };
+  static const size_t typeCount = SND_SEQ_EVENT_SENSING + 1;
+  static const size_t statusCount = 7 + 16;
+  static const size_t layoutSize[STATUS + 1];
+
+  // Channel messages are indexed by their upper nibble, system
+  // messages by their lower one.
+  static size_t statusIndex( unsigned char status ) {
+    return status < 0xf0 ? ( status >> 4 ) - 8 : 7 + ( status & 0x0f );
+  }
+
+  struct Tables {
+    Entry byStatus[statusCount];
+    Entry byType[typeCount];
+    Tables( );
+  };
+  static const Tables& tables( ) {
+    static const Tables t;
+    return t;
+  }
+};
+
+const size_t AlsaEventCodec::layoutSize[AlsaEventCodec::STATUS + 1] = {
+  0, 3, 3, 2, 3, 3, 1
+};
+
+// Both lookup tables are derived from a single list, so they cannot
+// disagree.
+AlsaEventCodec::Tables :: Tables( )
+{
+  static const Entry messages[] = {
+    { 0x80, SND_SEQ_EVENT_NOTEOFF,      NOTE },
+    { 0x90, SND_SEQ_EVENT_NOTEON,       NOTE },
+    { 0xa0, SND_SEQ_EVENT_KEYPRESS,     NOTE },
+    { 0xb0, SND_SEQ_EVENT_CONTROLLER,   CONTROL },
+    { 0xc0, SND_SEQ_EVENT_PGMCHANGE,    VALUE },
+    { 0xd0, SND_SEQ_EVENT_CHANPRESS,    VALUE },
+    { 0xe0, SND_SEQ_EVENT_PITCHBEND,    PITCHBEND },
+    { 0xf1, SND_SEQ_EVENT_QFRAME,       VALUE },
+    { 0xf2, SND_SEQ_EVENT_SONGPOS,      VALUE14 },
+    { 0xf3, SND_SEQ_EVENT_SONGSEL,      VALUE },
+    { 0xf6, SND_SEQ_EVENT_TUNE_REQUEST, STATUS },
+    { 0xf8, SND_SEQ_EVENT_CLOCK,        STATUS },
+    { 0xf9, SND_SEQ_EVENT_TICK,         STATUS },
+    { 0xfa, SND_SEQ_EVENT_START,        STATUS },
+    { 0xfb, SND_SEQ_EVENT_CONTINUE,     STATUS },
+    { 0xfc, SND_SEQ_EVENT_STOP,         STATUS },
+    { 0xfe, SND_SEQ_EVENT_SENSING,      STATUS },
+    { 0xff, SND_SEQ_EVENT_RESET,        STATUS }
+  };
+  Entry unsupported = { 0, SND_SEQ_EVENT_NONE, UNSUPPORTED };
+  std::fill( byStatus, byStatus + statusCount, unsupported );
+  std::fill( byType, byType + typeCount, unsupported );
+  for ( const Entry& entry : messages ) {
+    byStatus[statusIndex( entry.status )] = entry;
+    byType[entry.type] = entry;
+  }
+}
+#undef RTMIDI_CLASSNAME
+
+// Devices deliver SysEx messages in chunks of this size, and we send
+// them the same way.
+static const size_t alsaSysexChunkSize = 256;
+
 #define PORT_TYPE( pinfo, bits ) ( ( snd_seq_port_info_get_capability( pinfo ) & ( bits ) ) == ( bits ) )
 
 //*********************************************************************//
@@ -2711,11 +3757,33 @@ public:
   }
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
+  void setPortChangeCallback( PortChangeInterface * callback );
+  void setBufferSizes( const BufferSizes& sizes );
+  void setProtocol( MidiProtocol protocol );
 public:
   static void * alsaMidiHandler( void * ptr ) throw( );
   void initialize( );
+  bool startInput( );
+  void stopInput( );
+  void stopThread( );
+  void handleEvents( );
+  int inputEvent( snd_seq_event_t *& ev );
+  void handleEvent( snd_seq_event_t * ev );
+  double getTimeStamp( const snd_seq_event_t * event,
+                       int64_t & absoluteTime );
+  void doCallback( const snd_seq_event_t * event,
+                   const unsigned char * data,
+                   size_t size ) {
+    int64_t absoluteTime;
+    double timeStamp = getTimeStamp( event, absoluteTime );
+    deliverMessage( data, size, timeStamp, absoluteTime );
+  }
   void doCallback( const snd_seq_event_t * event,
-                   MidiMessage& message );
+                   std::vector<unsigned char>& data ) {
+    int64_t absoluteTime;
+    double timeStamp = getTimeStamp( event, absoluteTime );
+    deliverMessage( data, timeStamp, absoluteTime );
+  }
 
   /**
    * Decode and deliver a chunk of a system exclusive message.
@@ -2730,12 +3798,92 @@ public:
                   size_t old_size,
                   MidiMessage& message );
 
-  bool doAlsaEvent( snd_seq_event_t * event,
-                    MidiMessage& message );
+  bool doAlsaEvent( snd_seq_event_t * event );
+#ifdef RTMIDI_ALSA_UMP
+  void doUmpEvent( const snd_seq_ump_event_t * event );
+#endif
 
   friend class AlsaMidiData; // for registering the callback
+  friend class AlsaInputReactor;
+
+  // The shared thread that serves this input, if any.
+  AlsaInputReactor * reactor;
+  // Number of bytes of an unfinished SysEx message in message.
+  size_t sysexSize;
+  // Skip SysEx chunks until the end of a message that is too long.
+  bool discardSysex;
+  // Held by the input thread while it handles events. It is
+  // recursive, so that callbacks can close and reopen the port.
+  pthread_mutex_t inputMutex;
+  // Tells the input thread to quit.
+  std::atomic_bool terminate;
+};
+#undef RTMIDI_CLASSNAME
+
+/*! A thread that serves several ALSA inputs ( see \ref
+  MidiIn::setSharedInputThreads ). It polls the sequencers of all
+  registered inputs at once and lets each input handle its events.
+
+  The inputs are handled while the mutex is locked. So, after
+  remove( ) has returned, the thread does not access the input
+  anymore. The mutex is recursive, which allows a callback to close
+  its own port. Changes of the input list set the dirty flag, which
+  makes the thread rebuild its poll descriptors before it handles
+  any further events.
+
+  Several inputs may use the same sequencer ( see \ref
+  AlsaSharedClient ). Each sequencer is polled once and its events
+  are dispatched by their destination port. All inputs of a
+  sequencer must be attached to the same reactor.
+
+  Reactors are never destroyed. Their threads are reused by inputs
+  that are opened later.
+*/
+#define RTMIDI_CLASSNAME "AlsaInputReactor"
+class AlsaInputReactor {
+public:
+  static AlsaInputReactor * attach( MidiInAlsa * input );
+  void remove( MidiInAlsa * input );
+  static AlsaInputReactor * lockReader( AlsaSharedClient * shared,
+                                        AlsaInputReactor * reactor );
+  void unlock( ) { pthread_mutex_unlock( &mutex ); }
+protected:
+  AlsaInputReactor( );
+  ~AlsaInputReactor( );
+  bool start( );
+  void wakeup( );
+  MidiInAlsa * findInput( snd_seq_t * seq, int port = -1 );
+  void handleEvents( snd_seq_t * seq );
+  static void * reactorHandler( void * ptr ) throw( );
+
+  pthread_mutex_t mutex;
+  pthread_t thread;
+  bool dirty;
+  int trigger_fd; // eventfd
+  std::vector<MidiInAlsa *> inputs;
+  // Number of inputs. It is used to balance the load without taking
+  // the mutex, which may be held by a callback that opens a port.
+  std::atomic<size_t> load;
+
+  static pthread_mutex_t poolMutex;
+  static std::vector<AlsaInputReactor *> pool;
+};
+#undef RTMIDI_CLASSNAME
+
+// Keeps the reactor that reads the events of a sequencer from
+// handling them, e.g. while the input buffer is replaced.
+struct AlsaReaderLock {
+  AlsaInputReactor * reactor;
+  AlsaReaderLock( AlsaSharedClient * shared, AlsaInputReactor * own )
+    : reactor( AlsaInputReactor::lockReader( shared, own ) ) {}
+  ~AlsaReaderLock( ) {
+    if ( reactor )
+      reactor->unlock( );
+  }
 };
 
+#define RTMIDI_CLASSNAME "MidiInAlsa"
+
 inline MidiInApi * AlsaPortDescriptor :: getInputApi( unsigned int queueSizeLimit ) const {
   if ( getCapabilities( ) & INPUT )
     return new MidiInAlsa( clientName, queueSizeLimit );
@@ -2750,201 +3898,210 @@ inline MidiOutApi * AlsaPortDescriptor :: getOutputApi( ) const {
     return 0;
 }
 
-inline bool AlsaMidiData :: startQueue( void * userdata ) {
-  // Start the input queue
-#ifndef AVOID_TIMESTAMPING
-  seq.startQueue( queue_id );
-#endif
-  // Start our MIDI input thread.
-  pthread_attr_t attr;
-  pthread_attr_init( &attr );
-  pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_JOINABLE );
-  pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
-
-  int err = pthread_create( &thread, &attr, MidiInAlsa::alsaMidiHandler, userdata );
-  pthread_attr_destroy( &attr );
-  if ( err ) {
-    closePort( );
-    api->error( RTMIDI_ERROR( gettext_noopt( "Error starting MIDI input thread!" ),
-                              Error::THREAD_ERROR ) );
-    return false;
-  }
-  return true;
-}
-
 // static function:
 void * MidiInAlsa :: alsaMidiHandler( void * ptr ) throw( )
 {
   MidiInAlsa * data = static_cast<MidiInAlsa *> ( ptr );
 
-  bool doDecode = false;
-  size_t old_size = 0 ;
-  MidiInApi::MidiMessage message;
   int poll_fd_count;
   struct pollfd * poll_fds;
 
-  snd_seq_event_t * ev;
-  int result;
-  result = snd_midi_event_new( 0, &data->coder );
-  if ( result < 0 ) {
-    data->doInput = false;
-    try {
-      data->error( RTMIDI_ERROR( rtmidi_gettext( "Error initializing MIDI event parser." ),
-                                 Error::WARNING ) );
-    } catch ( Error& e ) {
-      // don't bother ALSA with an unhandled exception
-    }
-    return 0;
-  }
-
-  snd_midi_event_init( data->coder );
-#ifdef RTMIDI_DEBUG
-  snd_midi_event_no_status( data->coder, 0 ); // debug running status messages
-#else
-  snd_midi_event_no_status( data->coder, 1 ); // suppress running status messages
-#endif
-
   poll_fd_count = snd_seq_poll_descriptors_count( data->seq, POLLIN ) + 1;
   poll_fds = (struct pollfd*) alloca( poll_fd_count * sizeof( struct pollfd ) );
   snd_seq_poll_descriptors( data->seq, poll_fds + 1, poll_fd_count - 1, POLLIN );
-  poll_fds[0].fd = data->trigger_fds[0];
+  poll_fds[0].fd = data->trigger_fd;
   poll_fds[0].events = POLLIN;
 
-  while ( data->doInput ) {
-
-    if ( snd_seq_event_input_pending( data->seq, 1 ) == 0 ) {
-      // No data pending
-      if ( poll( poll_fds, poll_fd_count, -1 ) >= 0 ) {
-        if ( poll_fds[0].revents & POLLIN ) {
-          bool dummy;
-          int res = read( poll_fds[0].fd, &dummy, sizeof( dummy ) );
-          ( void ) res;
-        }
+  // The thread lives as long as the input. While the port is closed
+  // it drops all events, so closing and reopening is cheap.
+  while ( !data->terminate ) {
+    // Empty the input buffer before going back to sleep. Events that
+    // arrive while we are busy are fetched in the same pass.
+    pthread_mutex_lock( &data->inputMutex );
+    data->handleEvents( );
+    pthread_mutex_unlock( &data->inputMutex );
+    if ( data->terminate ) break;
+
+    if ( poll( poll_fds, poll_fd_count, -1 ) >= 0 ) {
+      if ( poll_fds[0].revents & POLLIN ) {
+        uint64_t value;
+        ssize_t res = read( poll_fds[0].fd, &value, sizeof( value ) );
+        ( void ) res;
       }
-      continue;
     }
+  }
 
-    // If here, there should be data.
-    result = snd_seq_event_input( data->seq, &ev );
-    if ( result == -ENOSPC ) {
-      try {
-        data->error( RTMIDI_ERROR( rtmidi_gettext( "MIDI input buffer overrun." ),
-                                   Error::WARNING ) );
-      } catch ( Error& e ) {
-        // don't bother ALSA with an unhandled exception
-      }
+  return 0;
+}
 
-      continue;
-    }
-    else if ( result == -EAGAIN ) {
-      try {
-        data->error( RTMIDI_ERROR( rtmidi_gettext( "ALSA returned without providing a MIDI event." ),
-                                   Error::WARNING ) );
-      } catch ( Error& e ) {
-        // don't bother ALSA with an unhandled exception
-      }
+// Handle all events that are available without blocking.
+//
+// The sequencer is opened in non-blocking mode, so
+// snd_seq_event_input( ) serves the events from its user space buffer
+// and refills the buffer with everything the kernel holds in a single
+// read( ). It returns -EAGAIN as soon as both are empty. Asking
+// snd_seq_event_input_pending( ) before each event would cost an
+// additional system call whenever the buffer runs dry.
+void MidiInAlsa :: handleEvents( )
+{
+  snd_seq_event_t * ev;
+  int result;
 
-      continue;
-    }
-    else if ( result <= 0 ) {
-      try {
-        data->error( RTMIDI_ERROR1( rtmidi_gettext( "Unknown MIDI input error.\nThe system reports:\n%s" ),
-                                    Error::WARNING,
-                                    strerror( -result ) ) );
-      } catch ( Error& e ) {
-        // don't bother ALSA with an unhandled exception
-      }
-      continue;
+  while ( ( result = inputEvent( ev ) ) != -EAGAIN ) {
+    if ( result < 0 ) {
+      if ( result == -ENOSPC ) continue;
+      break;
     }
 
-    // This is a bit weird, but we now have to decode an ALSA MIDI
-    // event ( back ) into MIDI bytes. We'll ignore non-MIDI types.
-    // TODO: provide an event based API
-
-    doDecode = false;
-    switch ( ev->type ) {
+    // Events that arrive while the port is closed are dropped.
+    if ( doInput )
+      handleEvent( ev );
+    snd_seq_free_event( ev );
+  }
+}
 
-      // ignore management data
-    case SND_SEQ_EVENT_PORT_SUBSCRIBED:
-#if defined( __RTMIDI_DEBUG__ )
-      std::cerr << "MidiInAlsa::alsaMidiHandler: port connection made!\n";
-      std::cerr << "sender = " << ( int ) ev->data.connect.sender.client << ":"
-                << ( int ) ev->data.connect.sender.port
-                << ", dest = " << ( int ) ev->data.connect.dest.client << ":"
-                << ( int ) ev->data.connect.dest.port
-                << std::endl;
+// Read the next event from the sequencer. Errors except for an empty
+// buffer are reported to this input. Returns the result of
+// snd_seq_event_input( ).
+int MidiInAlsa :: inputEvent( snd_seq_event_t *& ev )
+{
+#ifdef RTMIDI_ALSA_UMP
+  // UMP events start with the header of ordinary events. Which kind
+  // an event is, is told by its flags.
+  int result = protocol == MIDI_BYTE_STREAM
+    ? snd_seq_event_input( seq, &ev )
+    : snd_seq_ump_event_input( seq, reinterpret_cast<snd_seq_ump_event_t **>( &ev ) );
+#else
+  int result = snd_seq_event_input( seq, &ev );
 #endif
-      break;
+  if ( result >= 0 || result == -EAGAIN )
+    return result;
 
-    case SND_SEQ_EVENT_PORT_UNSUBSCRIBED:
-#if defined( __RTMIDI_DEBUG__ )
-      std::cerr << "MidiInAlsa::alsaMidiHandler: port connection has closed!\n";
-      std::cerr << "sender = " << ( int ) ev->data.connect.sender.client << ":"
-                << ( int ) ev->data.connect.sender.port
-                << ", dest = " << ( int ) ev->data.connect.dest.client << ":"
-                << ( int ) ev->data.connect.dest.port
-                << std::endl;
-#endif
-      break;
+  if ( result == -ENOSPC ) {
+    overruns++;
+    try {
+      error( RTMIDI_ERROR( rtmidi_gettext( "MIDI input buffer overrun." ),
+                           Error::WARNING ) );
+    } catch ( Error& e ) {
+      // don't bother ALSA with an unhandled exception
+    }
+  }
+  else {
+    try {
+      error( RTMIDI_ERROR1( rtmidi_gettext( "Unknown MIDI input error.\nThe system reports:\n%s" ),
+                            Error::WARNING,
+                            strerror( -result ) ) );
+    } catch ( Error& e ) {
+      // don't bother ALSA with an unhandled exception
+    }
+  }
+  return result;
+}
 
-    case SND_SEQ_EVENT_QFRAME: // MIDI time code
-    case SND_SEQ_EVENT_TICK: // 0xF9 ... MIDI timing tick
-    case SND_SEQ_EVENT_CLOCK: // 0xF8 ... MIDI timing ( clock ) tick
-      if ( !( data->ignoreFlags & IGNORE_TIME ) ) doDecode = true;
-      break;
+inline __attribute__( ( always_inline ) )
+void MidiInAlsa :: handleEvent( snd_seq_event_t * ev )
+{
+  // This is a bit weird, but we now have to decode an ALSA MIDI
+  // event ( back ) into MIDI bytes. We'll ignore non-MIDI types.
+  // TODO: provide an event based API
 
-    case SND_SEQ_EVENT_SENSING: // Active sensing
-      if ( !( data->ignoreFlags & IGNORE_SENSING ) ) doDecode = true;
-      break;
+#ifdef RTMIDI_ALSA_UMP
+  if ( snd_seq_ev_is_ump( ev ) ) {
+    doUmpEvent( reinterpret_cast<const snd_seq_ump_event_t *>( ev ) );
+    return;
+  }
+#endif
 
-    case SND_SEQ_EVENT_SYSEX:
-      if ( ( data->ignoreFlags & IGNORE_SYSEX ) ) break;
-      // decode message directly into the buffer
+  bool doDecode = false;
+  switch ( ev->type ) {
+
+    // ignore management data
+  case SND_SEQ_EVENT_PORT_SUBSCRIBED:
+#if defined( __RTMIDI_DEBUG__ )
+    std::cerr << "MidiInAlsa::alsaMidiHandler: port connection made!\n";
+    std::cerr << "sender = " << ( int ) ev->data.connect.sender.client << ":"
+              << ( int ) ev->data.connect.sender.port
+              << ", dest = " << ( int ) ev->data.connect.dest.client << ":"
+              << ( int ) ev->data.connect.dest.port
+              << std::endl;
+#endif
+    break;
 
-      // The ALSA sequencer has a maximum buffer size for MIDI sysex
-      // events of 256 bytes. If a device sends sysex messages larger
-      // than this, they are segmented into 256 byte chunks. So,
-      // we'll watch for this and concatenate sysex chunks into a
-      // single sysex message if necessary.
+  case SND_SEQ_EVENT_PORT_UNSUBSCRIBED:
+#if defined( __RTMIDI_DEBUG__ )
+    std::cerr << "MidiInAlsa::alsaMidiHandler: port connection has closed!\n";
+    std::cerr << "sender = " << ( int ) ev->data.connect.sender.client << ":"
+              << ( int ) ev->data.connect.sender.port
+              << ", dest = " << ( int ) ev->data.connect.dest.client << ":"
+              << ( int ) ev->data.connect.dest.port
+              << std::endl;
+#endif
+    break;
+
+  case SND_SEQ_EVENT_QFRAME: // MIDI time code
+  case SND_SEQ_EVENT_TICK: // 0xF9 ... MIDI timing tick
+  case SND_SEQ_EVENT_CLOCK: // 0xF8 ... MIDI timing ( clock ) tick
+    if ( !( ignoreFlags & IGNORE_TIME ) ) doDecode = true;
+    break;
+
+  case SND_SEQ_EVENT_SENSING: // Active sensing
+    if ( !( ignoreFlags & IGNORE_SENSING ) ) doDecode = true;
+    break;
+
+  case SND_SEQ_EVENT_SYSEX:
+    if ( ( ignoreFlags & IGNORE_SYSEX ) ) break;
+    // UMP clients get SysEx as packets.
+    if ( protocol != MIDI_BYTE_STREAM ) break;
+    // decode message directly into the buffer
+
+    // The ALSA sequencer has a maximum buffer size for MIDI sysex
+    // events of 256 bytes. If a device sends sysex messages larger
+    // than this, they are segmented into 256 byte chunks. So,
+    // we'll watch for this and concatenate sysex chunks into a
+    // single sysex message if necessary.
+    try {
+      sysexSize = doSysEx( ev,
+                           sysexSize,
+                           message );
+    } catch ( std::bad_alloc& e ) {
       try {
-        old_size = data->doSysEx( ev,
-                                  old_size,
-                                  message );
-      } catch ( std::bad_alloc& e ) {
-        doDecode = false;
-        try {
-          data->error( RTMIDI_ERROR( rtmidi_gettext( "Error resizing buffer memory." ),
-                                     Error::WARNING ) );
-        } catch ( Error& e ) {
-          // don't bother ALSA with an unhandled exception
-        }
+        error( RTMIDI_ERROR( rtmidi_gettext( "Error resizing buffer memory." ),
+                             Error::WARNING ) );
+      } catch ( Error& e ) {
+        // don't bother ALSA with an unhandled exception
       }
-      doDecode = false;
-      break;
-
-    default:
-      doDecode = true;
-    }
-
-    if ( doDecode ) {
-      if ( data->doAlsaEvent( ev, message ) )
-        old_size = 0; // stop decoding SysEx.
     }
+    break;
 
-    snd_seq_free_event( ev );
+  default:
+    doDecode = true;
   }
 
-  snd_midi_event_free( data->coder );
-  data->coder = 0;
-  data->thread = data->dummy_thread_id;
-  return 0;
+  // The kernel converts MIDI events for UMP clients. Anything else
+  // would be mixed up with the packets.
+  if ( doDecode && protocol == MIDI_BYTE_STREAM ) {
+    if ( doAlsaEvent( ev ) ) {
+      sysexSize = 0; // stop decoding SysEx.
+      discardSysex = false;
+    }
+  }
 }
 
 MidiInAlsa :: MidiInAlsa( const std::string& clientName,
                           unsigned int queueSizeLimit )
   : AlsaMidiData ( clientName ),
-    MidiInApi( queueSizeLimit )
-{
+    MidiInApi( queueSizeLimit ),
+    reactor( 0 ),
+    sysexSize( 0 ),
+    discardSysex( false ),
+    terminate( false )
+{
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init( &attr );
+  pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+  pthread_mutex_init( &inputMutex, &attr );
+  pthread_mutexattr_destroy( &attr );
+
   MidiInAlsa::initialize( );
 }
 
@@ -2954,18 +4111,13 @@ MidiInAlsa :: ~MidiInAlsa( )
   MidiInAlsa::closePort( );
 
   // Shutdown the input thread.
-  if ( doInput ) {
-    doInput = false;
-    int res = write( trigger_fds[1], &doInput, sizeof( doInput ) );
-    ( void ) res;
-    if ( !pthread_equal( thread, dummy_thread_id ) )
-      pthread_join( thread, NULL );
-  }
+  stopInput( );
+  stopThread( );
 
   // Cleanup.
   // TODO: Merge with AlsaMidiApi
   try {
-    if ( local.client && local.port )
+    if ( local.client )
       deletePort( );
   } catch ( const Error& e ) {
     // we don't have access to the error handler
@@ -2973,11 +4125,18 @@ MidiInAlsa :: ~MidiInAlsa( )
   }
 
 #ifndef AVOID_TIMESTAMPING
-  snd_seq_free_queue( seq, queue_id );
+  // A shared queue is freed with the client.
+  if ( !seq.shared )
+    snd_seq_free_queue( seq, queue_id );
   queue_id = -1;
 #endif
-  close ( trigger_fds[0] );
-  close ( trigger_fds[1] );
+  if ( coder ) {
+    snd_midi_event_free( coder );
+    coder = 0;
+  }
+  if ( trigger_fd >= 0 )
+    close( trigger_fd );
+  pthread_mutex_destroy( &inputMutex );
 }
 
 inline void MidiInAlsa :: initialize( )
@@ -2985,14 +4144,24 @@ inline void MidiInAlsa :: initialize( )
 
   // Save our api-specific connection information.
 
-  if ( pipe( trigger_fds ) == -1 ) {
-    error( RTMIDI_ERROR( gettext_noopt( "Error creating pipe objects." ),
+  if ( snd_midi_event_new( 0, &coder ) < 0 ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Error initializing MIDI event parser." ),
                          Error::DRIVER_ERROR ) );
     return;
   }
+  snd_midi_event_init( coder );
+#ifdef RTMIDI_DEBUG
+  snd_midi_event_no_status( coder, 0 ); // debug running status messages
+#else
+  snd_midi_event_no_status( coder, 1 ); // suppress running status messages
+#endif
 
   // Create the input queue
 #ifndef AVOID_TIMESTAMPING
+  if ( seq.shared ) {
+    queue_id = seq.shared->getQueue( );
+    return;
+  }
   queue_id = snd_seq_alloc_named_queue( seq, "Midi Queue" );
   // Set arbitrary tempo ( mm=100 ) and resolution ( 240 )
   snd_seq_queue_tempo_t * qtempo;
@@ -3004,84 +4173,111 @@ inline void MidiInAlsa :: initialize( )
 #endif
 }
 
-// helper functions to avoid compiler warnings
-template<class T>
-bool is_negative( const T& x ) {
-  return x < 0;
-}
-
-template<>
-bool is_negative<unsigned int>( const unsigned int& ) {
-  return false;
-}
-template<>
-bool is_negative<unsigned long>( const unsigned long& ) {
-  return false;
-}
+// Start the input queue and the thread that handles the input.
+bool MidiInAlsa :: startInput( )
+{
+#ifndef AVOID_TIMESTAMPING
+  if ( seq.shared ) {
+    queueStartTime = seq.shared->startQueue( );
+  } else {
+    seq.startQueue( queue_id );
+    queueStartTime = getAlsaQueueStartTime( seq, queue_id );
+  }
+#endif
+  {
+    // The input thread may still be dropping events.
+    scoped_lock<true> lock( inputMutex );
+    snd_midi_event_reset_decode( coder );
+    message.bytes.clear( );
+    sysexSize = 0;
+    discardSysex = false;
+    doInput = true;
+  }
 
-inline __attribute__( ( always_inline ) )
-void MidiInAlsa :: doCallback( const snd_seq_event_t * event,
-                               MidiMessage& message ) {
+  // An input thread from a previous connection is reused.
+  if ( !pthread_equal( thread, dummy_thread_id ) )
+    return true;
 
-  // Perform the carry for the later subtraction by updating y.
-  snd_seq_real_time_t x( event->time.time );
-  snd_seq_real_time_t y( lastTime );
+  if ( MidiIn::getSharedInputThreads( ) || seq.shared ) {
+    reactor = AlsaInputReactor::attach( this );
+    if ( reactor )
+      return true;
+  } else if ( trigger_fd >= 0
+              || ( trigger_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) >= 0 ) {
+    // Start our MIDI input thread.
+    pthread_attr_t attr;
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_JOINABLE );
+    pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
 
-  // normalize x
-  x.tv_sec += x.tv_nsec/1000000000;
-  x.tv_nsec = x.tv_nsec%1000000000;
-  while ( is_negative( x.tv_nsec ) ) {
-    x.tv_sec --;
-    x.tv_nsec += 1000000000;
+    int err = pthread_create( &thread, &attr, alsaMidiHandler, this );
+    pthread_attr_destroy( &attr );
+    if ( !err )
+      return true;
+    thread = dummy_thread_id;
   }
-  lastTime = x;
-
-
-  if ( firstMessage == true ) {
-    // y may not be normalised, but is ignored
-    message.timeStamp = 0.0;
-    firstMessage = false;
-  } else {
-    // y is normalized, both, x.tv_nsec and y.tv_nsec
-    // are between 0 and 1000000000
 
-    // Calculate the time stamp:
+  doInput = false;
+  error( RTMIDI_ERROR( gettext_noopt( "Error starting MIDI input thread!" ),
+                       Error::THREAD_ERROR ) );
+  return false;
+}
 
-    // Method 1: Use the system time.
-    //( void )gettimeofday( &tv, ( struct timezone * )NULL );
-    //time = ( tv.tv_sec * 1000000 ) + tv.tv_usec;
+// Stop the input, so that the callback is not triggered anymore.
+void MidiInAlsa :: stopInput( )
+{
+  if ( !doInput ) return;
 
-    // Method 2: Use the ALSA sequencer event time data.
-    // ( thanks to Pedro Lopez-Cabanillas! ).
+  doInput = false;
+  if ( reactor ) {
+    reactor->remove( this );
+    reactor = 0;
+  } else {
+    // The input thread checks doInput before each event. Wait until
+    // it has finished the current one.
+    scoped_lock<true> lock( inputMutex );
+  }
+}
 
-    if ( x.tv_nsec < y.tv_nsec ) {
-      --x.tv_sec;
-      x.tv_nsec += ( 1000000000 - y.tv_nsec );
-    } else {
-      x.tv_nsec -= y.tv_nsec;
-    }
-    x.tv_sec -= y.tv_sec;
+// Terminate the input thread. This is done only once, when the input
+// is destroyed.
+void MidiInAlsa :: stopThread( )
+{
+  if ( pthread_equal( thread, dummy_thread_id ) ) return;
 
-    // Compute the time difference.
-    double time = x.tv_sec + x.tv_nsec * 1e-9;
+  terminate = true;
+  uint64_t value = 1;
+  ssize_t res = write( trigger_fd, &value, sizeof( value ) );
+  ( void ) res;
+  pthread_join( thread, NULL );
+  thread = dummy_thread_id;
+}
 
+inline __attribute__( ( always_inline ) )
+double MidiInAlsa :: getTimeStamp( const snd_seq_event_t * event,
+                                  int64_t & absoluteTime ) {
+#ifndef AVOID_TIMESTAMPING
+  // The events carry the real time of our queue, which has been
+  // started at queueStartTime. The kernel keeps tv_nsec below one
+  // second, so no normalisation is necessary.
+  absoluteTime = queueStartTime
+    + int64_t( event->time.time.tv_sec ) * 1000000000
+    + event->time.time.tv_nsec;
+#else
+  ( void )event;
+  absoluteTime = Midi::getMonotonicTime( );
+#endif
 
-    message.timeStamp = time;
-  }
-  lastTime = event->time.time;
-  if ( userCallback )
-    userCallback->rtmidi_midi_in( message.timeStamp, message.bytes );
-  else {
-    // As long as we haven't reached our queue size limit, push the message.
-    if ( !queue.push( message ) ) {
-      try {
-        error( RTMIDI_ERROR( rtmidi_gettext( "Error: Message queue limit reached." ),
-                             Error::WARNING ) );
-      } catch ( Error& e ) {
-        // don't bother ALSA with an unhandled exception
-      }
-    }
+  double timeStamp;
+  if ( firstMessage == true ) {
+    timeStamp = 0.0;
+    firstMessage = false;
+  } else {
+    // The difference is exact, only the conversion to seconds rounds.
+    timeStamp = ( absoluteTime - lastTime ) * 1e-9;
   }
+  lastTime = absoluteTime;
+  return timeStamp;
 }
 
 /**
@@ -3098,31 +4294,74 @@ size_t MidiInAlsa :: doSysEx( snd_seq_event_t * event,
                               size_t old_size,
                               MidiInApi::MidiMessage& message )
 {
-  message.bytes.resize( old_size + event->data.ext.len );
-  long nBytes = alsa2Midi( event,
-                           &message.bytes[old_size],
-                           message.bytes.size( ) - old_size );
-  if ( nBytes > 0 ) {
-    old_size += nBytes;
-    if ( message.bytes[old_size - 1] == 0xF7 ) {
-      old_size = 0;
-      doCallback( event, message );
+  // The data of variable length events follows the event in the
+  // input buffer. It is appended to message.bytes without decoding.
+  if ( !snd_seq_ev_is_variable( event ) || !event->data.ext.len )
+    return old_size;
+  const unsigned char * data
+    = static_cast<const unsigned char *>( event->data.ext.ptr );
+  size_t size = event->data.ext.len;
+  bool complete = data[size - 1] == 0xF7;
+
+  // The rest of a message that exceeded maxSysexSize is skipped.
+  if ( discardSysex ) {
+    discardSysex = !complete;
+    return 0;
+  }
+
+  size_t needed = old_size + size;
+  size_t maxSize = maxSysexSize;
+  if ( maxSize && needed > maxSize ) {
+    discardSysex = !complete;
+    message.bytes.clear( );
+    try {
+      error( RTMIDI_ERROR( rtmidi_gettext( "SysEx message exceeds the maximum size. It has been dropped." ),
+                           Error::WARNING ) );
+    } catch ( Error& e ) {
+      // don't bother ALSA with an unhandled exception
     }
+    return 0;
   }
-  return old_size;
+
+  // message.bytes is the reassembly buffer. Its capacity is kept for
+  // later messages, and it grows geometrically, so that long messages
+  // need only a few allocations.
+  if ( needed > message.bytes.capacity( ) ) {
+    size_t capacity = std::max( needed, 2 * message.bytes.capacity( ) );
+    if ( maxSize )
+      capacity = std::min( capacity, maxSize );
+    message.bytes.reserve( capacity );
+  }
+  message.bytes.resize( old_size );
+  message.bytes.insert( message.bytes.end( ), data, data + size );
+
+  if ( complete ) {
+    // Vector based callbacks get the buffer itself.
+    doCallback( event, message.bytes );
+    return 0;
+  }
+  return needed;
 }
 
 inline __attribute__( ( always_inline ) )
-bool MidiInAlsa :: doAlsaEvent( snd_seq_event_t * event,
-                                MidiInApi::MidiMessage& message ) {
+bool MidiInAlsa :: doAlsaEvent( snd_seq_event_t * event ) {
+#ifndef RTMIDI_DEBUG
+  // The debug build exercises the running status of the decoder.
+  unsigned char bytes[3];
+  size_t size = AlsaEventCodec::decode( event, bytes );
+  if ( size ) {
+    doCallback( event, bytes, size );
+    return true;
+  }
+#endif
+
   // we don't have lengths information so we need a
   // secound buffer
   long nBytes = alsa2Midi( event,
                            buffer.data( ),
                            buffer.size( ) );
   if ( nBytes > 0 ) {
-    message.bytes.assign( buffer.data( ), buffer.data( ) + nBytes );
-    doCallback( event, message );
+    doCallback( event, buffer.data( ), nBytes );
     return true;
   } else {
 #if defined( __RTMIDI_DEBUG__ )
@@ -3137,6 +4376,30 @@ bool MidiInAlsa :: doAlsaEvent( snd_seq_event_t * event,
   }
 }
 
+#ifdef RTMIDI_ALSA_UMP
+// Deliver a Universal MIDI Packet as it is. Packets have a fixed size,
+// so nothing has to be decoded or reassembled.
+inline __attribute__( ( always_inline ) )
+void MidiInAlsa :: doUmpEvent( const snd_seq_ump_event_t * event )
+{
+  uint32_t word = event->ump[0];
+  unsigned int status = ( word >> 16 ) & 0xFF;
+  switch ( word >> 28 ) {
+  case 0x1: // System common and real time messages
+    if ( ( status == 0xF1 || status == 0xF8 || status == 0xF9 )
+         && ( ignoreFlags & IGNORE_TIME ) ) return;
+    if ( status == 0xFE && ( ignoreFlags & IGNORE_SENSING ) ) return;
+    break;
+  case 0x3: // 7 bit SysEx
+  case 0x5: // 8 bit SysEx and mixed data sets
+    if ( ignoreFlags & IGNORE_SYSEX ) return;
+    break;
+  }
+  doCallback( reinterpret_cast<const snd_seq_event_t *>( event ),
+              reinterpret_cast<const unsigned char *>( event->ump ),
+              Midi::getUmpPacketSize( word ) * sizeof( uint32_t ) );
+}
+#endif
 
 // This function is used to count or get the pinfo structure for a given port number.
 unsigned int portInfo( snd_seq_t * seq, snd_seq_port_info_t * pinfo, unsigned int type, int portNumber )
@@ -3285,27 +4548,10 @@ void MidiInAlsa :: openPort( unsigned int portNumber, const std::string& portNam
   }
 
   if ( doInput == false ) {
-    // Start the input queue
-#ifndef AVOID_TIMESTAMPING
-    snd_seq_start_queue( seq, queue_id, NULL );
-    snd_seq_drain_output( seq );
-#endif
-    // Start our MIDI input thread.
-    pthread_attr_t attr;
-    pthread_attr_init( &attr );
-    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_JOINABLE );
-    pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
-
-    doInput = true;
-    int err = pthread_create( &thread, &attr, alsaMidiHandler, this );
-    pthread_attr_destroy( &attr );
-    if ( err ) {
+    if ( !startInput( ) ) {
       snd_seq_unsubscribe_port( seq, subscription );
       snd_seq_port_subscribe_free( subscription );
       subscription = 0;
-      doInput = false;
-      error( RTMIDI_ERROR( gettext_noopt( "Error starting MIDI input thread!" ),
-                           Error::THREAD_ERROR ) );
       return;
     }
   }
@@ -3345,9 +4591,9 @@ void MidiInAlsa :: openPort( const PortDescriptor& port,
                   false );
 
 
-    if ( doInput == false ) {
-      doInput
-        = startQueue( this );
+    if ( doInput == false && !startInput( ) ) {
+      AlsaMidiData::closePort( );
+      return;
     }
 
     connected_ = true;
@@ -3384,6 +4630,41 @@ PortList MidiInAlsa :: getPortList( int capabilities )
   }
 }
 
+void MidiInAlsa :: setPortChangeCallback( PortChangeInterface * callback )
+{
+  try {
+    watchPorts( callback );
+  } catch ( Error& e ) {
+    error( e );
+  }
+}
+
+void MidiInAlsa :: setBufferSizes( const BufferSizes& sizes )
+{
+  try {
+    // Keep the thread that reads our events from using the buffers
+    // while they are replaced. This is either the reactor of our
+    // sequencer or our own input thread. Other objects of a shared
+    // client use the output buffer.
+    AlsaReaderLock reader( seq.shared, reactor );
+    scoped_lock<true> lock( inputMutex );
+    scoped_lock<true> outputLock( seq.outputMutex( ) );
+    seq.setBufferSizes( sizes );
+  } catch ( Error& e ) {
+    error( e );
+  }
+}
+
+void MidiInAlsa :: setProtocol( MidiProtocol protocol )
+{
+  try {
+    scoped_lock<true> lock( inputMutex );
+    AlsaMidiData::setProtocol( protocol );
+  } catch ( Error& e ) {
+    error( e );
+  }
+}
+
 
 
 void MidiInAlsa :: openVirtualPort( const std::string& portName )
@@ -3417,34 +4698,10 @@ void MidiInAlsa :: openVirtualPort( const std::string& portName )
   }
 
   if ( doInput == false ) {
-    // Wait for old thread to stop, if still running
-    if ( !pthread_equal( thread, dummy_thread_id ) )
-      pthread_join( thread, NULL );
-
-    // Start the input queue
-#ifndef AVOID_TIMESTAMPING
-    snd_seq_start_queue( seq, queue_id, NULL );
-    snd_seq_drain_output( seq );
-#endif
-    // Start our MIDI input thread.
-    pthread_attr_t attr;
-    pthread_attr_init( &attr );
-    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_JOINABLE );
-    pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
-
-    doInput = true;
-    int err = pthread_create( &thread, &attr, alsaMidiHandler, this );
-    pthread_attr_destroy( &attr );
-    if ( err ) {
-      if ( subscription ) {
-        snd_seq_unsubscribe_port( seq, subscription );
-        snd_seq_port_subscribe_free( subscription );
-        subscription = 0;
-      }
-      doInput = false;
-      error( RTMIDI_ERROR( gettext_noopt( "Error starting MIDI input thread!" ),
-                           Error::THREAD_ERROR ) );
-      return;
+    if ( !startInput( ) && subscription ) {
+      snd_seq_unsubscribe_port( seq, subscription );
+      snd_seq_port_subscribe_free( subscription );
+      subscription = 0;
     }
   }
 }
@@ -3457,74 +4714,316 @@ void MidiInAlsa :: closePort( void )
       snd_seq_port_subscribe_free( subscription );
       subscription = 0;
     }
-    // Stop the input queue
+    // Stop the input queue, unless it is shared with other inputs.
 #ifndef AVOID_TIMESTAMPING
-    snd_seq_stop_queue( seq, queue_id, NULL );
-    snd_seq_drain_output( seq );
+    if ( !seq.shared ) {
+      snd_seq_stop_queue( seq, queue_id, NULL );
+      snd_seq_drain_output( seq );
+    }
 #endif
     connected_ = false;
   }
 
   // Stop thread to avoid triggering the callback, while the port is intended to be closed
-  if ( doInput ) {
-    doInput = false;
-    int res = write( trigger_fds[1], &doInput, sizeof( doInput ) );
-    ( void ) res;
-    if ( !pthread_equal( thread, dummy_thread_id ) )
-      pthread_join( thread, NULL );
-  }
+  stopInput( );
 }
+#undef RTMIDI_CLASSNAME
 
 
-#undef RTMIDI_CLASSNAME
+#define RTMIDI_CLASSNAME "AlsaInputReactor"
+pthread_mutex_t AlsaInputReactor :: poolMutex = PTHREAD_MUTEX_INITIALIZER;
+std::vector<AlsaInputReactor *> AlsaInputReactor :: pool;
 
-//*********************************************************************//
-// API: LINUX ALSA
-// Class Definitions: MidiOutAlsa
-//*********************************************************************//
+AlsaInputReactor :: AlsaInputReactor( )
+  : dirty( true ),
+    load( 0 )
+{
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init( &attr );
+  pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+  pthread_mutex_init( &mutex, &attr );
+  pthread_mutexattr_destroy( &attr );
+  trigger_fd = -1;
+}
 
-#define RTMIDI_CLASSNAME "MidiOutAlsa"
-MidiOutAlsa :: MidiOutAlsa( const std::string& clientName )
-  : MidiOutApi( )
+// Only used if the thread could not be started.
+AlsaInputReactor :: ~AlsaInputReactor( )
 {
-  MidiOutAlsa::initialize( clientName );
+  pthread_mutex_destroy( &mutex );
 }
 
-MidiOutAlsa :: ~MidiOutAlsa( )
+bool AlsaInputReactor :: start( )
 {
-  // Close a connection if it exists.
-  MidiOutAlsa::closePort( );
+  // Wakeups must never block. The counter collects them until the
+  // thread reads it.
+  trigger_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+  if ( trigger_fd < 0 )
+    return false;
 
-  // Cleanup.
-  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
-  if ( data->local.client > 0 ) {
-    snd_seq_delete_port( data->seq, data->local.port );
-    data->local.port = -1;
-  }
-  if ( data->coder ) {
-    snd_midi_event_free( data->coder );
-    data->coder = 0;
+  pthread_attr_t attr;
+  pthread_attr_init( &attr );
+  pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+  pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
+
+  int err = pthread_create( &thread, &attr, reactorHandler, this );
+  pthread_attr_destroy( &attr );
+  if ( err ) {
+    close( trigger_fd );
+    trigger_fd = -1;
+    return false;
   }
-  delete data;
+  return true;
 }
 
-void MidiOutAlsa :: initialize( const std::string& clientName )
+// Register the input with the least busy reactor. A new reactor is
+// started as long as there are less than MidiIn::getSharedInputThreads( ).
+AlsaInputReactor * AlsaInputReactor :: attach( MidiInAlsa * input )
 {
-#if 0
-  // Set up the ALSA sequencer client.
-  snd_seq_t * seq;
-  int result1 = snd_seq_open( &seq, "default", SND_SEQ_OPEN_OUTPUT, SND_SEQ_NONBLOCK );
-  if ( result1 < 0 ) {
-    error( RTMIDI_ERROR( gettext_noopt( "Error creating ALSA sequencer client object." ),
-                         Error::DRIVER_ERROR, errorString_ ) );
-    return;
-  }
+  AlsaInputReactor * reactor = 0;
+  AlsaSharedClient * shared = input->seq.shared;
+  {
+    scoped_lock<true> poolLock( poolMutex );
+    // Only one reactor may read the events of a shared sequencer.
+    if ( shared && shared->readers ) {
+      reactor = shared->reactor;
+    } else {
+      // Shared clients need a reactor, even if no shared threads
+      // have been requested.
+      size_t threads = std::max( MidiIn::getSharedInputThreads( ), 1u );
+      size_t minLoad = 0;
+      for ( size_t i = 0; i < pool.size( ) && i < threads; i++ ) {
+        if ( !reactor || pool[i]->load < minLoad ) {
+          reactor = pool[i];
+          minLoad = reactor->load;
+        }
+      }
 
-  // Set client name.
-  snd_seq_set_client_name( seq, clientName.c_str( ) );
-#endif
+      if ( ( !reactor || minLoad ) && pool.size( ) < threads ) {
+        AlsaInputReactor * created = new AlsaInputReactor( );
+        if ( created->start( ) ) {
+          pool.push_back( created );
+          reactor = created;
+        } else {
+          delete created;
+        }
+      }
+      if ( !reactor ) return 0;
+    }
 
-  // Save our api-specific connection information.
+    ++reactor->load;
+    if ( shared ) {
+      shared->reactor = reactor;
+      ++shared->readers;
+    }
+  }
+
+  {
+    scoped_lock<true> lock( reactor->mutex );
+    reactor->inputs.push_back( input );
+    reactor->dirty = true;
+  }
+  reactor->wakeup( );
+  return reactor;
+}
+
+// Lock the reactor that reads from a sequencer. For a shared client
+// this is the reactor of its inputs, otherwise the given one. Returns
+// the locked reactor or 0 if there is none. The pool mutex must not
+// be held while the mutex of a reactor is locked, as callbacks lock
+// them in the opposite order. So, the reactor of a shared client is
+// checked again afterwards. It cannot change anymore then, as
+// remove( ) needs the mutex.
+AlsaInputReactor * AlsaInputReactor :: lockReader( AlsaSharedClient * shared,
+                                                   AlsaInputReactor * reactor )
+{
+  for ( ;; ) {
+    if ( shared ) {
+      scoped_lock<true> poolLock( poolMutex );
+      reactor = shared->readers ? shared->reactor : 0;
+    }
+    if ( !reactor )
+      return 0;
+    pthread_mutex_lock( &reactor->mutex );
+    if ( !shared )
+      return reactor;
+    {
+      scoped_lock<true> poolLock( poolMutex );
+      if ( shared->readers && shared->reactor == reactor )
+        return reactor;
+    }
+    pthread_mutex_unlock( &reactor->mutex );
+  }
+}
+
+void AlsaInputReactor :: remove( MidiInAlsa * input )
+{
+  {
+    // Waits until the input is not handled anymore.
+    scoped_lock<true> lock( mutex );
+    inputs.erase( std::remove( inputs.begin( ), inputs.end( ), input ),
+                  inputs.end( ) );
+    dirty = true;
+  }
+  {
+    scoped_lock<true> poolLock( poolMutex );
+    --load;
+    if ( input->seq.shared )
+      --input->seq.shared->readers;
+  }
+  wakeup( );
+}
+
+// Find an input that reads from seq and owns port. A negative port
+// matches any input of seq.
+MidiInAlsa * AlsaInputReactor :: findInput( snd_seq_t * seq, int port )
+{
+  for ( MidiInAlsa * input : inputs ) {
+    if ( input->seq.seq == seq && ( port < 0 || input->local.port == port ) )
+      return input;
+  }
+  return 0;
+}
+
+// Handle all events of seq that are available without blocking.
+// See MidiInAlsa::handleEvents( ).
+void AlsaInputReactor :: handleEvents( snd_seq_t * seq )
+{
+  snd_seq_event_t * ev;
+  MidiInAlsa * reader;
+  int result;
+
+  // A callback may close any of the inputs, so they are looked up
+  // again for each event.
+  while ( ( reader = findInput( seq ) )
+          && ( result = reader->inputEvent( ev ) ) != -EAGAIN ) {
+    if ( result < 0 ) {
+      if ( result == -ENOSPC ) continue;
+      break;
+    }
+
+    MidiInAlsa * input = findInput( seq, ev->dest.port );
+    if ( input && input->doInput )
+      input->handleEvent( ev );
+    snd_seq_free_event( ev );
+  }
+}
+
+void AlsaInputReactor :: wakeup( )
+{
+  uint64_t value = 1;
+  ssize_t res = write( trigger_fd, &value, sizeof( value ) );
+  ( void ) res;
+}
+
+// static function:
+void * AlsaInputReactor :: reactorHandler( void * ptr ) throw( )
+{
+  AlsaInputReactor * reactor = static_cast<AlsaInputReactor *> ( ptr );
+  std::vector<struct pollfd> poll_fds;
+  std::vector<snd_seq_t *> owners;
+
+  pthread_mutex_lock( &reactor->mutex );
+  for ( ;; ) {
+    if ( reactor->dirty ) {
+      // Rebuild the poll descriptors. owners[i] handles poll_fds[i].
+      poll_fds.resize( 1 );
+      owners.assign( 1, 0 );
+      poll_fds[0].fd = reactor->trigger_fd;
+      poll_fds[0].events = POLLIN;
+      for ( MidiInAlsa * input : reactor->inputs ) {
+        snd_seq_t * seq = input->seq;
+        if ( std::find( owners.begin( ), owners.end( ), seq ) != owners.end( ) )
+          continue;
+        size_t offset = poll_fds.size( );
+        int count = snd_seq_poll_descriptors_count( seq, POLLIN );
+        poll_fds.resize( offset + count );
+        owners.resize( offset + count, seq );
+        snd_seq_poll_descriptors( seq, &poll_fds[offset], count, POLLIN );
+      }
+      reactor->dirty = false;
+    }
+    pthread_mutex_unlock( &reactor->mutex );
+
+    int result = poll( poll_fds.data( ), poll_fds.size( ), -1 );
+    if ( result > 0 && ( poll_fds[0].revents & POLLIN ) ) {
+      uint64_t value;
+      ssize_t res = read( poll_fds[0].fd, &value, sizeof( value ) );
+      ( void ) res;
+    }
+
+    pthread_mutex_lock( &reactor->mutex );
+    if ( result <= 0 ) continue;
+    // handleEvents( ) ignores sequencers without inputs, which may
+    // have been closed, meanwhile.
+    for ( size_t i = 1; i < poll_fds.size( ); i++ ) {
+      if ( poll_fds[i].revents )
+        reactor->handleEvents( owners[i] );
+    }
+  }
+  return 0;
+}
+#undef RTMIDI_CLASSNAME
+
+//*********************************************************************//
+// API: LINUX ALSA
+// Class Definitions: MidiOutAlsa
+//*********************************************************************//
+
+#define RTMIDI_CLASSNAME "MidiOutAlsa"
+MidiOutAlsa :: MidiOutAlsa( const std::string& clientName )
+  : MidiOutApi( ),
+    pendingBytes( 0 ),
+    encoderBusy( false ),
+    runningStatus( 0 )
+{
+  MidiOutAlsa::initialize( clientName );
+}
+
+MidiOutAlsa :: ~MidiOutAlsa( )
+{
+  // Deliver buffered messages, e.g. of a virtual port.
+  try {
+    MidiOutAlsa::flush( );
+  } catch ( const Error& e ) {
+    e.printMessage( );
+  }
+
+  // Close a connection if it exists.
+  MidiOutAlsa::closePort( );
+
+  // Cleanup.
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  if ( data->local.client > 0 ) {
+    snd_seq_delete_port( data->seq, data->local.port );
+    data->local.port = -1;
+  }
+  if ( data->coder ) {
+    snd_midi_event_free( data->coder );
+    data->coder = 0;
+  }
+  // Pending scheduled messages are dropped with the queue.
+  if ( data->queue_id >= 0 && !data->seq.shared )
+    snd_seq_free_queue( data->seq, data->queue_id );
+  delete data;
+}
+
+void MidiOutAlsa :: initialize( const std::string& clientName )
+{
+#if 0
+  // Set up the ALSA sequencer client.
+  snd_seq_t * seq;
+  int result1 = snd_seq_open( &seq, "default", SND_SEQ_OPEN_OUTPUT, SND_SEQ_NONBLOCK );
+  if ( result1 < 0 ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Error creating ALSA sequencer client object." ),
+                         Error::DRIVER_ERROR, errorString_ ) );
+    return;
+  }
+
+  // Set client name.
+  snd_seq_set_client_name( seq, clientName.c_str( ) );
+#endif
+
+  // Save our api-specific connection information.
   AlsaMidiData * data = new AlsaMidiData( clientName );
   apiData_ = (void *) data;
   // data->seq = seq;
@@ -3623,180 +5122,1437 @@ void MidiOutAlsa :: openPort( unsigned int portNumber, const std::string& portNa
       return;
     }
 
-    data->local.port = port;
-  }
+    data->local.port = port;
+  }
+
+  // Make subscription
+  if ( snd_seq_port_subscribe_malloc( &data->subscription ) < 0 ) {
+    snd_seq_port_subscribe_free( data->subscription );
+    data->subscription = 0;
+    error( RTMIDI_ERROR( gettext_noopt( "Could not allocate ALSA port subscription." ),
+                         Error::DRIVER_ERROR ) );
+    return;
+  }
+  snd_seq_port_subscribe_set_sender( data->subscription, data );
+  snd_seq_port_subscribe_set_dest( data->subscription, &data->local );
+  snd_seq_port_subscribe_set_time_update( data->subscription, 1 );
+  snd_seq_port_subscribe_set_time_real( data->subscription, 1 );
+  if ( snd_seq_subscribe_port( data->seq, data->subscription ) ) {
+    snd_seq_port_subscribe_free( data->subscription );
+    data->subscription = 0;
+    error( RTMIDI_ERROR( gettext_noopt( "Error making ALSA port connection." ),
+                         Error::DRIVER_ERROR ) );
+    return;
+  }
+
+  connected_ = true;
+}
+
+void MidiOutAlsa :: closePort( void )
+{
+  if ( connected_ ) {
+    MidiOutAlsa::flush( );
+    AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+    snd_seq_unsubscribe_port( data->seq, data->subscription );
+    snd_seq_port_subscribe_free( data->subscription );
+    data->subscription = 0;
+    connected_ = false;
+  }
+}
+
+void MidiOutAlsa :: setClientName( const std::string& clientName )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  data->setClientName( clientName );
+}
+
+void MidiOutAlsa :: setPortName( const std::string& portName )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  data->setName( portName );
+}
+
+void MidiOutAlsa :: openVirtualPort( const std::string& portName )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  if ( !data->local.client ) {
+    int port = snd_seq_create_simple_port( data->seq, portName.c_str( ),
+                                           SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ,
+                                           SND_SEQ_PORT_TYPE_MIDI_GENERIC|SND_SEQ_PORT_TYPE_APPLICATION );
+
+    if ( port < 0 ) {
+      error( RTMIDI_ERROR( gettext_noopt( "Error creating ALSA virtual port." ),
+                           Error::DRIVER_ERROR ) );
+    }
+    data->local.port = port;
+    data->local.client = snd_seq_client_id( data->seq );
+  }
+}
+
+void MidiOutAlsa :: sendMessage( const unsigned char * message, size_t size )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+
+  // The output buffer of a shared client is used by all of its ports.
+  scoped_lock<true> lock( data->seq.outputMutex( ) );
+
+  if ( encodeMessage( message, size ) )
+    autoFlush( );
+}
+
+// All messages are encoded into the output buffer before it is
+// drained, so the whole batch needs a single system call.
+void MidiOutAlsa :: sendMessages( const unsigned char * messages,
+                                  const size_t * offsets,
+                                  size_t count )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  scoped_lock<true> lock( data->seq.outputMutex( ) );
+
+  size_t i;
+  for ( i = 0; i < count; i++ ) {
+    if ( !encodeMessage( messages + offsets[i],
+                         offsets[i + 1] - offsets[i] ) )
+      break;
+  }
+  // Messages that have been encoded before an error are sent, anyway.
+  if ( i )
+    autoFlush( );
+}
+
+// Upper limit of the space that the events of a message take in the
+// output buffer. A complete SysEx message is split into chunks. Any
+// other data yields at most one fixed size event per byte, which
+// holds for Universal MIDI Packets, too.
+static size_t alsaOutputSpace( const unsigned char * message, size_t size,
+                               bool packets )
+{
+  if ( !packets && size >= 2 && message[0] == 0xF0 && message[size - 1] == 0xF7 )
+    return size + ( size / alsaSysexChunkSize + 1 ) * sizeof( snd_seq_event_t );
+  return size * sizeof( snd_seq_event_t );
+}
+
+// snd_seq_event_output( ) drains the output buffer when it is full. On
+// our non-blocking client that fails as soon as the kernel pool is full,
+// possibly in the middle of a message. So, a message is encoded only if
+// the buffer has room for all of its events, and a message that cannot
+// fit at all is rejected as soon as it is the first one of a call. Thus
+// no partial message is left behind, and the caller doesn't wait for
+// room that never comes.
+// Whatever the kernel does not take stays in the buffer and goes first
+// next time.
+size_t MidiOutAlsa :: trySendMessages( const unsigned char * messages,
+                                       const size_t * offsets,
+                                       size_t count )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  scoped_lock<true> lock( data->seq.outputMutex( ) );
+
+  size_t bufferSize = snd_seq_get_output_buffer_size( data->seq );
+  size_t accepted = 0;
+  for ( ; accepted < count; accepted++ ) {
+    const unsigned char * message = messages + offsets[accepted];
+    size_t size = offsets[accepted + 1] - offsets[accepted];
+    size_t space = alsaOutputSpace( message, size,
+                                    data->protocol != MIDI_BYTE_STREAM );
+    if ( space > bufferSize ) {
+      // Send the preceding messages, first.
+      if ( accepted )
+        break;
+      drainOutput( );
+      error( RTMIDI_ERROR( gettext_noopt( "The MIDI message is too large for the ALSA output buffer." ),
+                           Error::INVALID_PARAMETER ) );
+      // An error callback has been informed. The message is dropped.
+      continue;
+    }
+    size_t pending = snd_seq_event_output_pending( data->seq );
+    if ( pending && pending + space > bufferSize ) {
+      drainOutput( );
+      if ( snd_seq_event_output_pending( data->seq ) )
+        break;
+    }
+    if ( !encodeMessage( message, size ) )
+      break;
+  }
+  drainOutput( );
+  return accepted;
+}
+
+int MidiOutAlsa :: getPollDescriptor( )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  struct pollfd poll_fd;
+  if ( snd_seq_poll_descriptors( data->seq, &poll_fd, 1, POLLOUT ) != 1 )
+    return -1;
+  return poll_fd.fd;
+}
+
+void MidiOutAlsa :: scheduleMessage( const unsigned char * message,
+                                     size_t size,
+                                     int64_t time )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  // This must be done before the output mutex is locked, as a shared
+  // client protects its queue with the same mutex.
+  if ( !startQueue( ) )
+    return;
+
+  // The queue has been started at queueStartTime. Earlier times are due
+  // immediately.
+  int64_t delay = std::max( time - data->queueStartTime, int64_t( 0 ) );
+
+  scoped_lock<true> lock( data->seq.outputMutex( ) );
+
+  if ( encodeMessage( message, size, delay ) )
+    autoFlush( );
+}
+
+void MidiOutAlsa :: flush( )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  scoped_lock<true> lock( data->seq.outputMutex( ) );
+  drainOutput( );
+}
+
+// Allocate and start the queue for scheduled output on first use.
+bool MidiOutAlsa :: startQueue( )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  if ( data->queue_id >= 0 )
+    return true;
+
+  if ( data->seq.shared ) {
+    int queue_id = data->seq.shared->getQueue( );
+    if ( queue_id >= 0 ) {
+      data->queueStartTime = data->seq.shared->startQueue( );
+      data->queue_id = queue_id;
+      return true;
+    }
+  } else {
+    int queue_id = snd_seq_alloc_named_queue( data->seq, "Midi Output Queue" );
+    if ( queue_id >= 0 ) {
+      data->seq.startQueue( queue_id );
+      data->queueStartTime = getAlsaQueueStartTime( data->seq, queue_id );
+      data->queue_id = queue_id;
+      return true;
+    }
+  }
+
+  error( RTMIDI_ERROR( gettext_noopt( "Error creating ALSA output queue." ),
+                       Error::DRIVER_ERROR ) );
+  return false;
+}
+
+// Clear an event and address it to the subscribers of port. A delay
+// of -1 sends it directly, otherwise it is scheduled on the queue.
+// The header of UMP events is the same as of ordinary events.
+template <class Event>
+static void setAlsaEventHeader( Event * ev, int port, int queue_id,
+                                int64_t delay )
+{
+  memset( ev, 0, sizeof( *ev ) );
+  snd_seq_ev_set_source( ev, port );
+  snd_seq_ev_set_subs( ev );
+  if ( delay >= 0 ) {
+    snd_seq_real_time_t time;
+    time.tv_sec = delay / 1000000000;
+    time.tv_nsec = delay % 1000000000;
+    snd_seq_ev_schedule_real( ev, queue_id, 0, &time );
+  } else {
+    snd_seq_ev_set_direct( ev );
+  }
+}
+
+// Return the running status after the given bytes have been sent.
+static unsigned char alsaRunningStatus( unsigned char status,
+                                        const unsigned char * message,
+                                        size_t size )
+{
+  for ( size_t i = 0; i < size; i++ ) {
+    if ( message[i] >= 0xF8 ) // real time
+      continue;
+    if ( message[i] >= 0xF0 ) // system common and SysEx
+      status = 0;
+    else if ( message[i] & 0x80 )
+      status = message[i];
+  }
+  return status;
+}
+
+// Write the events of a message into the output buffer. ALSA drains
+// the buffer on its own when it is full. Unless delay is negative, the
+// events are scheduled on the output queue delay nanoseconds after it
+// has been started. The caller must hold the output mutex.
+bool MidiOutAlsa :: encodeMessage( const unsigned char * message, size_t size,
+                                   int64_t delay )
+{
+  long result;
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+
+  pendingBytes += size;
+
+  if ( data->protocol != MIDI_BYTE_STREAM )
+    return encodePackets( message, size, delay );
+
+  snd_seq_event_t ev;
+  setAlsaEventHeader( &ev, data->local.port, data->queue_id, delay );
+
+  // A single short message that continues the running status is
+  // completed with the status byte.
+  const unsigned char * shortMessage = message;
+  size_t shortSize = size;
+  unsigned char expanded[3];
+  if ( !encoderBusy && runningStatus && size && size < sizeof( expanded )
+       && message[0] < 0x80 ) {
+    expanded[0] = runningStatus;
+    memcpy( expanded + 1, message, size );
+    shortMessage = expanded;
+    shortSize = size + 1;
+  }
+
+  // A single complete short message does not need the parser, unless
+  // the parser is waiting for the rest of a previous message.
+  if ( !encoderBusy && AlsaEventCodec::encode( shortMessage, shortSize, &ev ) ) {
+    if ( snd_seq_event_output( data->seq, &ev ) < 0 ) {
+      error( RTMIDI_ERROR( gettext_noopt( "Error sending MIDI message to port." ),
+                           Error::WARNING ) );
+      return false;
+    }
+    runningStatus = alsaRunningStatus( runningStatus, shortMessage, 1 );
+    return true;
+  }
+
+  // A single complete SysEx message is sent as variable length events
+  // that point into the caller's buffer. snd_seq_event_output( ) copies
+  // them into the output buffer, so the parser and its buffer are not
+  // involved. The chunks keep the events small enough for the input
+  // pools of receiving clients.
+  if ( !encoderBusy && size >= 2
+       && message[0] == 0xF0 && message[size - 1] == 0xF7
+       && !memchr( message + 1, 0xF7, size - 2 ) ) {
+    runningStatus = 0;
+    while ( size ) {
+      size_t chunk = std::min( size, alsaSysexChunkSize );
+      snd_seq_ev_set_sysex( &ev, chunk, const_cast<unsigned char *>( message ) );
+      if ( snd_seq_event_output( data->seq, &ev ) < 0 ) {
+        error( RTMIDI_ERROR( gettext_noopt( "Error sending MIDI message to port." ),
+                             Error::WARNING ) );
+        return false;
+      }
+      message += chunk;
+      size -= chunk;
+    }
+    return true;
+  }
+
+  if ( size > data->buffer.size( ) ) {
+    result = snd_midi_event_resize_buffer ( data->coder, size );
+    if ( result != 0 ) {
+      error( RTMIDI_ERROR( gettext_noopt( "ALSA error resizing MIDI event buffer." ),
+                           Error::DRIVER_ERROR ) );
+      return false;
+    }
+  }
+
+  // The parser has not seen the status bytes of the fast paths. So,
+  // data bytes at the start continue our running status.
+  if ( !encoderBusy && size && message[0] < 0x80 ) {
+    snd_midi_event_reset_encode( data->coder );
+    if ( runningStatus )
+      snd_midi_event_encode_byte( data->coder, runningStatus, &ev );
+  }
+  runningStatus = alsaRunningStatus( runningStatus, message, size );
+
+  // In case there are more messages in the stream we send everything
+  while ( size && ( result = snd_midi_event_encode( data->coder,
+                                                    message,
+                                                    size, &ev ) ) > 0 ) {
+    encoderBusy = ( ev.type == SND_SEQ_EVENT_NONE );
+    // Send the event.
+    if ( snd_seq_event_output( data->seq, &ev ) < 0 ) {
+      error( RTMIDI_ERROR( gettext_noopt( "Error sending MIDI message to port." ),
+                           Error::WARNING ) );
+      return false;
+    }
+    if ( size < (size_t) result ) {
+      error( RTMIDI_ERROR( gettext_noopt( "ALSA consumed more bytes than availlable." ),
+                           Error::WARNING ) );
+      return false;
+    }
+    message += result;
+    size -= result;
+  }
+  return true;
+}
+
+// Send Universal MIDI Packets, one event per packet.
+bool MidiOutAlsa :: encodePackets( const unsigned char * message, size_t size,
+                                   int64_t delay )
+{
+#ifdef RTMIDI_ALSA_UMP
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  if ( size % sizeof( uint32_t ) ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Universal MIDI Packets must consist of 32 bit words." ),
+                         Error::WARNING ) );
+    return false;
+  }
+
+  snd_seq_ump_event_t ev;
+  setAlsaEventHeader( &ev, data->local.port, data->queue_id, delay );
+  ev.flags |= SND_SEQ_EVENT_UMP;
+
+  while ( size ) {
+    // The caller's buffer may not be aligned.
+    uint32_t word;
+    memcpy( &word, message, sizeof( word ) );
+    size_t bytes = Midi::getUmpPacketSize( word ) * sizeof( uint32_t );
+    if ( bytes > size ) {
+      error( RTMIDI_ERROR( gettext_noopt( "Incomplete Universal MIDI Packet." ),
+                           Error::WARNING ) );
+      return false;
+    }
+    memset( ev.ump, 0, sizeof( ev.ump ) );
+    memcpy( ev.ump, message, bytes );
+    if ( snd_seq_ump_event_output( data->seq, &ev ) < 0 ) {
+      error( RTMIDI_ERROR( gettext_noopt( "Error sending MIDI message to port." ),
+                           Error::WARNING ) );
+      return false;
+    }
+    message += bytes;
+    size -= bytes;
+  }
+  return true;
+#else
+  ( void ) message;
+  ( void ) size;
+  ( void ) delay;
+  return false;
+#endif
+}
+
+// Drain the output buffer as requested by the flush policy. The caller
+// must hold the output mutex.
+void MidiOutAlsa :: autoFlush( )
+{
+  switch ( flushPolicy ) {
+  case MidiOut::FLUSH_IMMEDIATE:
+    drainOutput( );
+    break;
+  case MidiOut::FLUSH_ON_SIZE:
+    if ( pendingBytes >= flushSize )
+      drainOutput( );
+    break;
+  case MidiOut::FLUSH_EXPLICIT:
+    break;
+  }
+}
+
+// The caller must hold the output mutex.
+void MidiOutAlsa :: drainOutput( )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  int result = snd_seq_drain_output( data->seq );
+  // Bytes that are left in the buffer still count for the flush policy.
+  if ( result == 0 )
+    pendingBytes = 0;
+  // -EAGAIN: The kernel pool is full. The rest is sent with the next drain.
+  if ( result < 0 && result != -EAGAIN ) {
+    error( RTMIDI_ERROR1( gettext_noopt( "Error sending MIDI messages to port.\nThe system reports:\n%s" ),
+                          Error::WARNING,
+                          snd_strerror( result ) ) );
+  }
+}
+
+void MidiOutAlsa :: openPort( const PortDescriptor& port,
+                              const std::string& portName )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  const AlsaPortDescriptor * remote = dynamic_cast<const AlsaPortDescriptor *>( &port );
+
+  if ( !data ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Data has not been allocated." ),
+                         Error::SYSTEM_ERROR ) );
+    return;
+  }
+  if ( connected_ ) {
+    error( RTMIDI_ERROR( gettext_noopt( "A valid connection already exists." ),
+                         Error::WARNING ) );
+    return;
+  }
+  if ( data->subscription ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Error allocating ALSA port subscription." ),
+                         Error::DRIVER_ERROR ) );
+    return;
+  }
+  if ( !remote ) {
+    error( RTMIDI_ERROR( gettext_noopt( "ALSA has been instructed to open a non-ALSA MIDI port. This doesn't work." ),
+                         Error::INVALID_DEVICE ) );
+    return;
+  }
+
+  try {
+    if ( !data->local.client )
+      data->createPort ( SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+                         portName );
+    data->setRemote( remote );
+    data->connectPorts( data->local, *remote, true );
+
+    connected_ = true;
+  } catch ( Error& e ) {
+    error ( e );
+  }
+}
+Pointer<PortDescriptor> MidiOutAlsa :: getDescriptor( bool isLocal )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  try {
+    if ( isLocal ) {
+      if ( data && data->local.client ) {
+        return Pointer<PortDescriptor>(
+                                       new AlsaPortDescriptor( data->local, data->getClientName( ) ) );
+      }
+    } else {
+      if ( data && data->client ) {
+        return Pointer<PortDescriptor>(
+                                       new AlsaPortDescriptor( *data, data->getClientName( ) ) );
+      }
+    }
+  } catch ( Error& e ) {
+    error( e );
+  }
+  return NULL;
+}
+PortList MidiOutAlsa :: getPortList( int capabilities )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  try {
+    return AlsaPortDescriptor::getPortList( capabilities | PortDescriptor::OUTPUT,
+                                            data->getClientName( ) );
+  } catch ( Error& e ) {
+    return PortList( );
+  }
+}
+
+void MidiOutAlsa :: setPortChangeCallback( PortChangeInterface * callback )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  try {
+    data->watchPorts( callback );
+  } catch ( Error& e ) {
+    error( e );
+  }
+}
+
+void MidiOutAlsa :: setBufferSizes( const BufferSizes& sizes )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  // The input buffer of a shared client is read by a reactor. It is
+  // locked first, as its callbacks may send messages.
+  AlsaReaderLock reader( data->seq.shared, 0 );
+  scoped_lock<true> lock( data->seq.outputMutex( ) );
+  // Buffered messages would be lost.
+  drainOutput( );
+  try {
+    data->seq.setBufferSizes( sizes );
+  } catch ( Error& e ) {
+    error( e );
+  }
+}
+
+void MidiOutAlsa :: setProtocol( MidiProtocol protocol )
+{
+  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
+  scoped_lock<true> lock( data->seq.outputMutex( ) );
+  // Buffered messages must be sent in their own format.
+  drainOutput( );
+  try {
+    data->setProtocol( protocol );
+  } catch ( Error& e ) {
+    error( e );
+  }
+}
+#undef RTMIDI_CLASSNAME
+
+
+//*********************************************************************//
+// API: LINUX ALSA raw MIDI
+//*********************************************************************//
+
+// The raw MIDI interface exchanges the bytes of the MIDI stream with
+// the driver of a device. There is no sequencer between the
+// application and the hardware: no routing, no virtual ports, no
+// timestamping queue and no event encoding. Each message crosses the
+// kernel boundary once, which makes this the API with the lowest
+// latency for devices that are used by a single application.
+//
+// A device can be opened by one application at a time. For testing
+// without hardware the kernel module snd-virmidi provides raw MIDI
+// devices that are connected to the sequencer.
+
+class MidiInAlsaRaw;
+class MidiOutAlsaRaw;
+
+#define RTMIDI_CLASSNAME "AlsaRawPortDescriptor"
+/*! A raw MIDI subdevice. It is identified by the ALSA device name
+  "hw:card,device,subdevice". Both directions of a device use the same
+  subdevice numbers.
+*/
+struct AlsaRawPortDescriptor : public PortDescriptor
+{
+  AlsaRawPortDescriptor( const std::string& name )
+    : card( -1 ),
+      device( 0 ),
+      subdevice( 0 ),
+      capabilities( 0 ),
+      clientName( name ) {}
+  ~AlsaRawPortDescriptor( ) {}
+
+  MidiInApi * getInputApi( unsigned int queueSizeLimit = 100 ) const;
+  MidiOutApi * getOutputApi( ) const;
+  std::string getName( int flags = SHORT_NAME | UNIQUE_PORT_NAME );
+  int getCapabilities( ) const { return capabilities; }
+  bool operator == ( const PortDescriptor& o ) {
+    const AlsaRawPortDescriptor * desc = dynamic_cast<const AlsaRawPortDescriptor *>( &o );
+    if ( !desc ) return false;
+    return card == desc->card
+      && device == desc->device
+      && subdevice == desc->subdevice;
+  }
+
+  // The name for snd_rawmidi_open( ).
+  std::string getDeviceName( ) const {
+    return "hw:" + std::to_string( card )
+      + "," + std::to_string( device )
+      + "," + std::to_string( subdevice );
+  }
+
+  static PortList getPortList( int capabilities, const std::string& clientName );
+
+  int card;
+  int device;
+  int subdevice;
+  int capabilities;
+  std::string cardId;
+  std::string cardName;
+  std::string subdeviceName;
+  std::string clientName;
+};
+
+std::string AlsaRawPortDescriptor :: getName( int flags )
+{
+  std::string name;
+  switch ( flags & NAMING_MASK ) {
+  case SESSION_PATH:
+    if ( flags & INCLUDE_API ) name = "ALSARAW:";
+    name += getDeviceName( );
+    break;
+  case STORAGE_PATH:
+    if ( flags & INCLUDE_API ) name = "ALSARAW:";
+    name += cardId + ":" + subdeviceName;
+    if ( flags & UNIQUE_PORT_NAME )
+      name += ";" + getDeviceName( );
+    break;
+  case LONG_NAME:
+    name = cardName + ": " + subdeviceName;
+    if ( flags & UNIQUE_PORT_NAME )
+      name += " " + getDeviceName( );
+    if ( flags & INCLUDE_API )
+      name += " ( ALSA raw MIDI )";
+    break;
+  case SHORT_NAME:
+  default:
+    name = subdeviceName;
+    if ( flags & UNIQUE_PORT_NAME )
+      name += " " + getDeviceName( );
+    if ( flags & INCLUDE_API )
+      name += " ( ALSA raw MIDI )";
+    break;
+  }
+  return name;
+}
+
+PortList AlsaRawPortDescriptor :: getPortList( int capabilities, const std::string& clientName )
+{
+  static const snd_rawmidi_stream_t streams[2] = {
+    SND_RAWMIDI_STREAM_INPUT,
+    SND_RAWMIDI_STREAM_OUTPUT
+  };
+  PortList list;
+  snd_ctl_card_info_t * cardInfo;
+  snd_rawmidi_info_t * info;
+  snd_ctl_card_info_alloca( &cardInfo );
+  snd_rawmidi_info_alloca( &info );
+
+  int card = -1;
+  while ( snd_card_next( &card ) >= 0 && card >= 0 ) {
+    snd_ctl_t * ctl;
+    std::string ctlName = "hw:" + std::to_string( card );
+    if ( snd_ctl_open( &ctl, ctlName.c_str( ), 0 ) < 0 )
+      continue;
+    if ( snd_ctl_card_info( ctl, cardInfo ) < 0 ) {
+      snd_ctl_close( ctl );
+      continue;
+    }
+
+    int device = -1;
+    while ( snd_ctl_rawmidi_next_device( ctl, &device ) >= 0 && device >= 0 ) {
+      unsigned int counts[2] = { 0, 0 };
+      snd_rawmidi_info_set_device( info, device );
+      for ( int s = 0; s < 2; s++ ) {
+        snd_rawmidi_info_set_stream( info, streams[s] );
+        snd_rawmidi_info_set_subdevice( info, 0 );
+        if ( snd_ctl_rawmidi_info( ctl, info ) >= 0 )
+          counts[s] = snd_rawmidi_info_get_subdevices_count( info );
+      }
+
+      unsigned int subdevices = std::max( counts[0], counts[1] );
+      for ( unsigned int sub = 0; sub < subdevices; sub++ ) {
+        int caps = ( sub < counts[0] ? INPUT : 0 ) | ( sub < counts[1] ? OUTPUT : 0 );
+        if ( ( caps & capabilities & INOUTPUT ) != ( capabilities & INOUTPUT ) )
+          continue;
+        snd_rawmidi_info_set_stream( info, streams[ sub < counts[0] ? 0 : 1 ] );
+        snd_rawmidi_info_set_subdevice( info, sub );
+        if ( snd_ctl_rawmidi_info( ctl, info ) < 0 )
+          continue;
+
+        AlsaRawPortDescriptor * port = new AlsaRawPortDescriptor( clientName );
+        port->card = card;
+        port->device = device;
+        port->subdevice = sub;
+        port->capabilities = caps;
+        port->cardId = snd_ctl_card_info_get_id( cardInfo );
+        port->cardName = snd_ctl_card_info_get_name( cardInfo );
+        const char * name = snd_rawmidi_info_get_subdevice_name( info );
+        port->subdeviceName = ( name && *name ) ? name : snd_rawmidi_info_get_name( info );
+        list.push_back( Pointer<PortDescriptor>( port ) );
+      }
+    }
+    snd_ctl_close( ctl );
+  }
+  return list;
+}
+
+// Find a port by its number in the port list.
+static const AlsaRawPortDescriptor * findAlsaRawPort( const PortList& list,
+                                                     unsigned int portNumber )
+{
+  if ( portNumber >= list.size( ) ) return 0;
+  PortList::const_iterator i = list.begin( );
+  std::advance( i, portNumber );
+  return dynamic_cast<const AlsaRawPortDescriptor *>( &**i );
+}
+#undef RTMIDI_CLASSNAME
+
+#define RTMIDI_CLASSNAME "MidiInAlsaRaw"
+/*! Input from a raw MIDI device.
+
+  The input thread lives as long as the object. It polls the device
+  and an eventfd, which is used to stop the thread and to tell it that
+  the device has been replaced. The device is read and parsed while
+  inputMutex is locked. The mutex is recursive, so that a callback can
+  close its own port.
+*/
+class MidiInAlsaRaw : public MidiInApi {
+public:
+  MidiInAlsaRaw( const std::string& clientName, unsigned int queueSizeLimit );
+  ~MidiInAlsaRaw( void );
+  ApiType getCurrentApi( void ) throw( ) { return rtmidi::LINUX_ALSA_RAW; };
+  bool hasVirtualPorts( ) const { return false; }
+  void openPort( unsigned int portNumber, const std::string& portName );
+  void openVirtualPort( const std::string& portName );
+  void openPort( const PortDescriptor& port, const std::string& portName );
+  Pointer<PortDescriptor> getDescriptor( bool isLocal=false );
+  PortList getPortList( int capabilities );
+  void closePort( void );
+  void setClientName( const std::string& clientName );
+  void setPortName( const std::string& portName );
+  unsigned int getPortCount( void );
+  std::string getPortName( unsigned int portNumber );
+
+protected:
+  static void * rawMidiHandler( void * ptr ) throw( );
+  bool startThread( );
+  void wakeup( );
+  void handleInput( );
+
+  std::string clientName;
+  AlsaRawPortDescriptor remote;
+  snd_rawmidi_t * handle;
+  MidiStreamParser parser;
+  int64_t lastTime;
+  // The poll descriptors of the input thread are out of date.
+  bool dirty;
+  bool threadRunning;
+  pthread_t thread;
+  int trigger_fd; // eventfd
+  pthread_mutex_t inputMutex;
+  std::atomic_bool terminate;
+};
+
+MidiInAlsaRaw :: MidiInAlsaRaw( const std::string& name,
+                                unsigned int queueSizeLimit )
+  : MidiInApi( queueSizeLimit ),
+    clientName( name ),
+    remote( name ),
+    handle( 0 ),
+    lastTime( 0 ),
+    dirty( true ),
+    threadRunning( false ),
+    trigger_fd( -1 ),
+    terminate( false )
+{
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init( &attr );
+  pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+  pthread_mutex_init( &inputMutex, &attr );
+  pthread_mutexattr_destroy( &attr );
+}
+
+MidiInAlsaRaw :: ~MidiInAlsaRaw( )
+{
+  MidiInAlsaRaw::closePort( );
+
+  if ( threadRunning ) {
+    terminate = true;
+    wakeup( );
+    pthread_join( thread, NULL );
+  }
+  if ( trigger_fd >= 0 )
+    close( trigger_fd );
+  pthread_mutex_destroy( &inputMutex );
+}
+
+// static function:
+void * MidiInAlsaRaw :: rawMidiHandler( void * ptr ) throw( )
+{
+  MidiInAlsaRaw * data = static_cast<MidiInAlsaRaw *> ( ptr );
+  std::vector<struct pollfd> poll_fds;
+
+  while ( !data->terminate ) {
+    {
+      scoped_lock<true> lock( data->inputMutex );
+      if ( data->dirty ) {
+        struct pollfd trigger;
+        trigger.fd = data->trigger_fd;
+        trigger.events = POLLIN;
+        trigger.revents = 0;
+        poll_fds.assign( 1, trigger );
+        if ( data->handle ) {
+          int count = snd_rawmidi_poll_descriptors_count( data->handle );
+          poll_fds.resize( count + 1 );
+          snd_rawmidi_poll_descriptors( data->handle, &poll_fds[1], count );
+        }
+        data->dirty = false;
+      }
+      if ( data->handle )
+        data->handleInput( );
+    }
+    if ( data->terminate ) break;
+
+    if ( poll( poll_fds.data( ), poll_fds.size( ), -1 ) >= 0 ) {
+      if ( poll_fds[0].revents & POLLIN ) {
+        uint64_t value;
+        ssize_t res = read( poll_fds[0].fd, &value, sizeof( value ) );
+        ( void ) res;
+      }
+    }
+  }
+
+  return 0;
+}
+
+// Read and deliver everything the driver holds. The caller must hold
+// the input mutex.
+void MidiInAlsaRaw :: handleInput( )
+{
+  unsigned char buffer[256];
+  snd_rawmidi_t * current = handle;
+  // A callback may close or replace the device.
+  while ( handle == current ) {
+    ssize_t result = snd_rawmidi_read( handle, buffer, sizeof( buffer ) );
+    if ( result == -EAGAIN ) return;
+    if ( result < 0 ) {
+      // The device has probably been unplugged. Closing it keeps the
+      // thread from spinning on the error. The port counts as closed,
+      // so that it can be opened again.
+      snd_rawmidi_close( handle );
+      handle = 0;
+      dirty = true;
+      connected_ = false;
+      try {
+        error( RTMIDI_ERROR1( gettext_noopt( "Error reading from the raw MIDI device. The port has been closed.\nThe system reports:\n%s" ),
+                              Error::DRIVER_ERROR,
+                              snd_strerror( result ) ) );
+      } catch ( Error& e ) {
+        // don't bother ALSA with an unhandled exception
+      }
+      return;
+    }
+
+    // All messages of one read share the time of its arrival.
+    int64_t absoluteTime = Midi::getMonotonicTime( );
+    bool dropped = parser.parse( buffer, result, maxSysexSize,
+                                 ignoreFlags & IGNORE_SYSEX,
+                                 [this, current, absoluteTime]
+                                 ( const unsigned char * message, size_t size ) {
+      if ( handle != current ) return;
+      switch ( message[0] ) {
+      case 0xF1: // MIDI time code
+      case 0xF8: // timing clock
+      case 0xF9: // timing tick
+        if ( ignoreFlags & IGNORE_TIME ) return;
+        break;
+      case 0xFE: // active sensing
+        if ( ignoreFlags & IGNORE_SENSING ) return;
+        break;
+      }
+      double timeStamp = 0.0;
+      if ( firstMessage )
+        firstMessage = false;
+      else
+        timeStamp = ( absoluteTime - lastTime ) * 1e-9;
+      lastTime = absoluteTime;
+      deliverMessage( message, size, timeStamp, absoluteTime );
+    } );
+    if ( dropped ) {
+      try {
+        error( RTMIDI_ERROR( gettext_noopt( "SysEx message exceeds the maximum size. It has been dropped." ),
+                             Error::WARNING ) );
+      } catch ( Error& e ) {
+        // don't bother ALSA with an unhandled exception
+      }
+    }
+  }
+}
+
+bool MidiInAlsaRaw :: startThread( )
+{
+  if ( threadRunning ) return true;
+  if ( trigger_fd < 0
+       && ( trigger_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) < 0 ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Error starting MIDI input thread!" ),
+                         Error::THREAD_ERROR ) );
+    return false;
+  }
+
+  pthread_attr_t attr;
+  pthread_attr_init( &attr );
+  pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_JOINABLE );
+  pthread_attr_setschedpolicy( &attr, SCHED_OTHER );
+  int err = pthread_create( &thread, &attr, rawMidiHandler, this );
+  pthread_attr_destroy( &attr );
+  if ( err ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Error starting MIDI input thread!" ),
+                         Error::THREAD_ERROR ) );
+    return false;
+  }
+  threadRunning = true;
+  return true;
+}
+
+void MidiInAlsaRaw :: wakeup( )
+{
+  uint64_t value = 1;
+  ssize_t res = write( trigger_fd, &value, sizeof( value ) );
+  ( void ) res;
+}
+
+void MidiInAlsaRaw :: openPort( const PortDescriptor& port,
+                                const std::string& /*portName*/ )
+{
+  const AlsaRawPortDescriptor * desc = dynamic_cast<const AlsaRawPortDescriptor *>( &port );
+
+  if ( connected_ ) {
+    error( RTMIDI_ERROR( gettext_noopt( "A valid connection already exists." ),
+                         Error::WARNING ) );
+    return;
+  }
+  if ( !desc ) {
+    error( RTMIDI_ERROR( gettext_noopt( "ALSA raw MIDI has been instructed to open a non-ALSA raw MIDI port. This doesn't work." ),
+                         Error::INVALID_DEVICE ) );
+    return;
+  }
+  if ( !startThread( ) )
+    return;
+
+  snd_rawmidi_t * input;
+  int result = snd_rawmidi_open( &input, NULL, desc->getDeviceName( ).c_str( ),
+                                 SND_RAWMIDI_NONBLOCK );
+  if ( result < 0 ) {
+    error( RTMIDI_ERROR1( gettext_noopt( "Could not open the raw MIDI device.\nThe system reports:\n%s" ),
+                          Error::DRIVER_ERROR,
+                          snd_strerror( result ) ) );
+    return;
+  }
+
+  {
+    scoped_lock<true> lock( inputMutex );
+    remote.card = desc->card;
+    remote.device = desc->device;
+    remote.subdevice = desc->subdevice;
+    remote.capabilities = desc->capabilities;
+    remote.cardId = desc->cardId;
+    remote.cardName = desc->cardName;
+    remote.subdeviceName = desc->subdeviceName;
+    parser.reset( );
+    handle = input;
+    dirty = true;
+  }
+  wakeup( );
+  connected_ = true;
+}
+
+void MidiInAlsaRaw :: openPort( unsigned int portNumber,
+                                const std::string& portName )
+{
+  PortList list = getPortList( PortDescriptor::INPUT );
+  if ( list.empty( ) ) {
+    error( RTMIDI_ERROR( gettext_noopt( "No MIDI input sources found." ),
+                         Error::NO_DEVICES_FOUND ) );
+    return;
+  }
+  const AlsaRawPortDescriptor * port = findAlsaRawPort( list, portNumber );
+  if ( !port ) {
+    error( RTMIDI_ERROR1( gettext_noopt( "The 'portNumber' argument ( %d ) is invalid." ),
+                          Error::INVALID_PARAMETER,
+                          portNumber ) );
+    return;
+  }
+  openPort( *port, portName );
+}
+
+void MidiInAlsaRaw :: openVirtualPort( const std::string& /*portName*/ )
+{
+  error( RTMIDI_ERROR( gettext_noopt( "Virtual ports are not available with ALSA raw MIDI." ),
+                       Error::WARNING ) );
+}
+
+void MidiInAlsaRaw :: closePort( void )
+{
+  if ( !connected_ ) return;
+
+  {
+    scoped_lock<true> lock( inputMutex );
+    if ( handle )
+      snd_rawmidi_close( handle );
+    handle = 0;
+    dirty = true;
+  }
+  wakeup( );
+  connected_ = false;
+}
+
+Pointer<PortDescriptor> MidiInAlsaRaw :: getDescriptor( bool isLocal )
+{
+  if ( isLocal || !connected_ )
+    return NULL;
+  return Pointer<PortDescriptor>( new AlsaRawPortDescriptor( remote ) );
+}
+
+PortList MidiInAlsaRaw :: getPortList( int capabilities )
+{
+  return AlsaRawPortDescriptor::getPortList( capabilities | PortDescriptor::INPUT,
+                                             clientName );
+}
+
+void MidiInAlsaRaw :: setClientName( const std::string& )
+{
+  error( RTMIDI_ERROR( gettext_noopt( "Setting the client name is not supported by ALSA raw MIDI." ),
+                       Error::WARNING ) );
+}
+
+void MidiInAlsaRaw :: setPortName( const std::string& )
+{
+  error( RTMIDI_ERROR( gettext_noopt( "Setting the port name is not supported by ALSA raw MIDI." ),
+                       Error::WARNING ) );
+}
+
+unsigned int MidiInAlsaRaw :: getPortCount( )
+{
+  return getPortList( PortDescriptor::INPUT ).size( );
+}
+
+std::string MidiInAlsaRaw :: getPortName( unsigned int portNumber )
+{
+  PortList list = getPortList( PortDescriptor::INPUT );
+  if ( portNumber < list.size( ) ) {
+    PortList::iterator i = list.begin( );
+    std::advance( i, portNumber );
+    return ( *i )->getName( );
+  }
+  error( RTMIDI_ERROR( gettext_noopt( "Error looking for port name." ),
+                       Error::WARNING ) );
+  return std::string( );
+}
+#undef RTMIDI_CLASSNAME
+
+#define RTMIDI_CLASSNAME "MidiOutAlsaRaw"
+/*! Output to a raw MIDI device.
+
+  The device is opened in non-blocking mode. A message is written only
+  when the buffer of the driver has room for all of its bytes, so a
+  stalled device cannot leave a truncated message on the wire. Only
+  messages that are larger than the whole buffer are written in
+  pieces. Blocking calls wait in poll( ) for free space, but not longer
+  than alsaRawWriteTimeout.
+*/
+class MidiOutAlsaRaw : public MidiOutApi {
+public:
+  MidiOutAlsaRaw( const std::string& clientName );
+  ~MidiOutAlsaRaw( void );
+  ApiType getCurrentApi( void ) throw( ) { return rtmidi::LINUX_ALSA_RAW; };
+  bool hasVirtualPorts( ) const { return false; }
+  void openPort( unsigned int portNumber, const std::string& portName );
+  void openVirtualPort( const std::string& portName );
+  void openPort( const PortDescriptor& port, const std::string& portName );
+  Pointer<PortDescriptor> getDescriptor( bool isLocal=false );
+  PortList getPortList( int capabilities );
+  void closePort( void );
+  void setClientName( const std::string& clientName );
+  void setPortName( const std::string& portName );
+  unsigned int getPortCount( void );
+  std::string getPortName( unsigned int portNumber );
+  void sendMessage( const unsigned char * message, size_t size );
+  void sendMessages( const unsigned char * data,
+                     const size_t * offsets,
+                     size_t count );
+  size_t trySendMessages( const unsigned char * data,
+                          const size_t * offsets,
+                          size_t count );
+  int getPollDescriptor( );
+
+protected:
+  size_t writeSpace( );
+  void setAvailMin( size_t size );
+  bool waitForSpace( size_t size );
+  bool writeBytes( const unsigned char * data, size_t size );
+  size_t fittingMessages( const size_t * offsets, size_t count,
+                          size_t space );
+
+  std::string clientName;
+  AlsaRawPortDescriptor remote;
+  snd_rawmidi_t * handle;
+  size_t bufferSize; // size of the buffer of the driver
+  size_t availMin; // free space that makes the device writable
+};
+
+// Time in milliseconds that a blocking call waits for a raw MIDI
+// device to accept data.
+static const int alsaRawWriteTimeout = 1000;
+
+MidiOutAlsaRaw :: MidiOutAlsaRaw( const std::string& name )
+  : MidiOutApi( ),
+    clientName( name ),
+    remote( name ),
+    handle( 0 ),
+    bufferSize( 0 ),
+    availMin( 1 )
+{
+}
+
+MidiOutAlsaRaw :: ~MidiOutAlsaRaw( )
+{
+  MidiOutAlsaRaw::closePort( );
+}
+
+void MidiOutAlsaRaw :: openPort( const PortDescriptor& port,
+                                 const std::string& /*portName*/ )
+{
+  const AlsaRawPortDescriptor * desc = dynamic_cast<const AlsaRawPortDescriptor *>( &port );
 
-  // Make subscription
-  if ( snd_seq_port_subscribe_malloc( &data->subscription ) < 0 ) {
-    snd_seq_port_subscribe_free( data->subscription );
-    data->subscription = 0;
-    error( RTMIDI_ERROR( gettext_noopt( "Could not allocate ALSA port subscription." ),
-                         Error::DRIVER_ERROR ) );
+  if ( connected_ ) {
+    error( RTMIDI_ERROR( gettext_noopt( "A valid connection already exists." ),
+                         Error::WARNING ) );
     return;
   }
-  snd_seq_port_subscribe_set_sender( data->subscription, data );
-  snd_seq_port_subscribe_set_dest( data->subscription, &data->local );
-  snd_seq_port_subscribe_set_time_update( data->subscription, 1 );
-  snd_seq_port_subscribe_set_time_real( data->subscription, 1 );
-  if ( snd_seq_subscribe_port( data->seq, data->subscription ) ) {
-    snd_seq_port_subscribe_free( data->subscription );
-    data->subscription = 0;
-    error( RTMIDI_ERROR( gettext_noopt( "Error making ALSA port connection." ),
-                         Error::DRIVER_ERROR ) );
+  if ( !desc ) {
+    error( RTMIDI_ERROR( gettext_noopt( "ALSA raw MIDI has been instructed to open a non-ALSA raw MIDI port. This doesn't work." ),
+                         Error::INVALID_DEVICE ) );
+    return;
+  }
+
+  int result = snd_rawmidi_open( NULL, &handle, desc->getDeviceName( ).c_str( ),
+                                 SND_RAWMIDI_NONBLOCK );
+  if ( result < 0 ) {
+    handle = 0;
+    error( RTMIDI_ERROR1( gettext_noopt( "Could not open the raw MIDI device.\nThe system reports:\n%s" ),
+                          Error::DRIVER_ERROR,
+                          snd_strerror( result ) ) );
     return;
   }
 
+  snd_rawmidi_params_t * params;
+  snd_rawmidi_params_alloca( &params );
+  snd_rawmidi_params_current( handle, params );
+  bufferSize = snd_rawmidi_params_get_buffer_size( params );
+  availMin = 1;
+
+  remote.card = desc->card;
+  remote.device = desc->device;
+  remote.subdevice = desc->subdevice;
+  remote.capabilities = desc->capabilities;
+  remote.cardId = desc->cardId;
+  remote.cardName = desc->cardName;
+  remote.subdeviceName = desc->subdeviceName;
   connected_ = true;
 }
 
-void MidiOutAlsa :: closePort( void )
+void MidiOutAlsaRaw :: openPort( unsigned int portNumber,
+                                 const std::string& portName )
 {
-  if ( connected_ ) {
-    AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
-    snd_seq_unsubscribe_port( data->seq, data->subscription );
-    snd_seq_port_subscribe_free( data->subscription );
-    data->subscription = 0;
-    connected_ = false;
+  PortList list = getPortList( PortDescriptor::OUTPUT );
+  if ( list.empty( ) ) {
+    error( RTMIDI_ERROR( gettext_noopt( "No MIDI output destinations found." ),
+                         Error::NO_DEVICES_FOUND ) );
+    return;
+  }
+  const AlsaRawPortDescriptor * port = findAlsaRawPort( list, portNumber );
+  if ( !port ) {
+    error( RTMIDI_ERROR1( gettext_noopt( "The 'portNumber' argument ( %d ) is invalid." ),
+                          Error::INVALID_PARAMETER,
+                          portNumber ) );
+    return;
   }
+  openPort( *port, portName );
 }
 
-void MidiOutAlsa :: setClientName( const std::string& clientName )
+void MidiOutAlsaRaw :: openVirtualPort( const std::string& /*portName*/ )
 {
-  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
-  data->setClientName( clientName );
+  error( RTMIDI_ERROR( gettext_noopt( "Virtual ports are not available with ALSA raw MIDI." ),
+                       Error::WARNING ) );
 }
 
-void MidiOutAlsa :: setPortName( const std::string& portName )
+void MidiOutAlsaRaw :: closePort( void )
 {
-  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
-  data->setName( portName );
+  if ( !connected_ ) return;
+
+  // Let the driver send what is left in its buffer.
+  snd_rawmidi_drain( handle );
+  snd_rawmidi_close( handle );
+  handle = 0;
+  connected_ = false;
 }
 
-void MidiOutAlsa :: openVirtualPort( const std::string& portName )
+Pointer<PortDescriptor> MidiOutAlsaRaw :: getDescriptor( bool isLocal )
 {
-  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
-  if ( !data->local.client ) {
-    int port = snd_seq_create_simple_port( data->seq, portName.c_str( ),
-                                           SND_SEQ_PORT_CAP_READ|SND_SEQ_PORT_CAP_SUBS_READ,
-                                           SND_SEQ_PORT_TYPE_MIDI_GENERIC|SND_SEQ_PORT_TYPE_APPLICATION );
+  if ( isLocal || !connected_ )
+    return NULL;
+  return Pointer<PortDescriptor>( new AlsaRawPortDescriptor( remote ) );
+}
 
-    if ( port < 0 ) {
-      error( RTMIDI_ERROR( gettext_noopt( "Error creating ALSA virtual port." ),
-                           Error::DRIVER_ERROR ) );
-    }
-    data->local.port = port;
-    data->local.client = snd_seq_client_id( data->seq );
-  }
+PortList MidiOutAlsaRaw :: getPortList( int capabilities )
+{
+  return AlsaRawPortDescriptor::getPortList( capabilities | PortDescriptor::OUTPUT,
+                                             clientName );
 }
 
-void MidiOutAlsa :: sendMessage( const unsigned char * message, size_t size )
+void MidiOutAlsaRaw :: setClientName( const std::string& )
 {
-  long result;
-  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
-  if ( size > data->buffer.size( ) ) {
-    result = snd_midi_event_resize_buffer ( data->coder, size );
-    if ( result != 0 ) {
-      error( RTMIDI_ERROR( gettext_noopt( "ALSA error resizing MIDI event buffer." ),
-                           Error::DRIVER_ERROR ) );
-      return;
-    }
+  error( RTMIDI_ERROR( gettext_noopt( "Setting the client name is not supported by ALSA raw MIDI." ),
+                       Error::WARNING ) );
+}
+
+void MidiOutAlsaRaw :: setPortName( const std::string& )
+{
+  error( RTMIDI_ERROR( gettext_noopt( "Setting the port name is not supported by ALSA raw MIDI." ),
+                       Error::WARNING ) );
+}
+
+unsigned int MidiOutAlsaRaw :: getPortCount( )
+{
+  return getPortList( PortDescriptor::OUTPUT ).size( );
+}
+
+std::string MidiOutAlsaRaw :: getPortName( unsigned int portNumber )
+{
+  PortList list = getPortList( PortDescriptor::OUTPUT );
+  if ( portNumber < list.size( ) ) {
+    PortList::iterator i = list.begin( );
+    std::advance( i, portNumber );
+    return ( *i )->getName( );
   }
+  error( RTMIDI_ERROR( gettext_noopt( "Error looking for port name." ),
+                       Error::WARNING ) );
+  return std::string( );
+}
 
-  snd_seq_event_t ev;
-  snd_seq_ev_clear( &ev );
-  snd_seq_ev_set_source( &ev, data->local.port );
-  snd_seq_ev_set_subs( &ev );
-  snd_seq_ev_set_direct( &ev );
+// Return the number of bytes that the driver accepts without waiting.
+size_t MidiOutAlsaRaw :: writeSpace( )
+{
+  snd_rawmidi_status_t * status;
+  snd_rawmidi_status_alloca( &status );
+  if ( snd_rawmidi_status( handle, status ) < 0 )
+    return 0;
+  return snd_rawmidi_status_get_avail( status );
+}
 
-  // In case there are more messages in the stream we send everything
-  while ( size && ( result = snd_midi_event_encode( data->coder,
-                                                    message,
-                                                    size, &ev ) ) > 0 ) {
-    // Send the event.
-    if ( snd_seq_event_output( data->seq, &ev ) < 0 ) {
-      error( RTMIDI_ERROR( gettext_noopt( "Error sending MIDI message to port." ),
+// Let the poll descriptors report the device as writable only when it
+// has room for size bytes.
+void MidiOutAlsaRaw :: setAvailMin( size_t size )
+{
+  size = std::max( std::min( size, bufferSize ), size_t( 1 ) );
+  if ( size == availMin )
+    return;
+  snd_rawmidi_params_t * params;
+  snd_rawmidi_params_alloca( &params );
+  snd_rawmidi_params_current( handle, params );
+  snd_rawmidi_params_set_avail_min( handle, params, size );
+  if ( snd_rawmidi_params( handle, params ) == 0 )
+    availMin = size;
+}
+
+// Wait until the driver has room for size bytes, but at most for its
+// whole buffer. Returns false if the device does not get ready in
+// time.
+bool MidiOutAlsaRaw :: waitForSpace( size_t size )
+{
+  size = std::min( size, bufferSize );
+  if ( writeSpace( ) >= size )
+    return true;
+
+  setAvailMin( size );
+  int count = snd_rawmidi_poll_descriptors_count( handle );
+  struct pollfd * poll_fds = (struct pollfd*) alloca( count * sizeof( struct pollfd ) );
+  snd_rawmidi_poll_descriptors( handle, poll_fds, count );
+  int64_t deadline = Midi::getMonotonicTime( )
+    + int64_t( alsaRawWriteTimeout ) * 1000000;
+  while ( writeSpace( ) < size ) {
+    int64_t left = deadline - Midi::getMonotonicTime( );
+    if ( left <= 0 ) {
+      error( RTMIDI_ERROR( gettext_noopt( "The raw MIDI device does not accept data. The message has not been sent." ),
                            Error::WARNING ) );
-      return;
+      return false;
     }
-    snd_seq_drain_output( data->seq );
-    if ( size < (size_t) result ) {
-      error( RTMIDI_ERROR( gettext_noopt( "ALSA consumed more bytes than availlable." ),
-                           Error::WARNING ) );
-      return;
+    poll( poll_fds, count, int( left / 1000000 ) + 1 );
+  }
+  return true;
+}
+
+// Write the bytes of whole messages. Unless a message is larger than
+// the buffer of the driver, the caller has made sure that there is
+// room for them.
+bool MidiOutAlsaRaw :: writeBytes( const unsigned char * data, size_t size )
+{
+  while ( size ) {
+    ssize_t result = snd_rawmidi_write( handle, data, size );
+    if ( result >= 0 ) {
+      data += result;
+      size -= result;
+      continue;
     }
-    message += result;
-    size -= result;
+    if ( result != -EAGAIN ) {
+      error( RTMIDI_ERROR1( gettext_noopt( "Error sending MIDI messages to port.\nThe system reports:\n%s" ),
+                            Error::WARNING,
+                            snd_strerror( result ) ) );
+      return false;
+    }
+    // The rest of a message that is larger than the buffer.
+    if ( !waitForSpace( size ) )
+      return false;
   }
+  return true;
 }
 
-void MidiOutAlsa :: openPort( const PortDescriptor& port,
-                              const std::string& portName )
+// Return the number of messages at the beginning that fit into space
+// bytes.
+size_t MidiOutAlsaRaw :: fittingMessages( const size_t * offsets,
+                                          size_t count,
+                                          size_t space )
 {
-  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
-  const AlsaPortDescriptor * remote = dynamic_cast<const AlsaPortDescriptor *>( &port );
+  size_t n = 0;
+  while ( n < count && offsets[n + 1] - offsets[0] <= space )
+    n++;
+  return n;
+}
 
-  if ( !data ) {
-    error( RTMIDI_ERROR( gettext_noopt( "Data has not been allocated." ),
-                         Error::SYSTEM_ERROR ) );
-    return;
-  }
-  if ( connected_ ) {
-    error( RTMIDI_ERROR( gettext_noopt( "A valid connection already exists." ),
+void MidiOutAlsaRaw :: sendMessage( const unsigned char * message, size_t size )
+{
+  size_t offsets[2] = { 0, size };
+  sendMessages( message, offsets, 1 );
+}
+
+// As many messages as the driver has room for leave in a single write.
+void MidiOutAlsaRaw :: sendMessages( const unsigned char * data,
+                                     const size_t * offsets,
+                                     size_t count )
+{
+  if ( !handle ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Error sending MIDI message to port." ),
                          Error::WARNING ) );
     return;
   }
-  if ( data->subscription ) {
-    error( RTMIDI_ERROR( gettext_noopt( "Error allocating ALSA port subscription." ),
-                         Error::DRIVER_ERROR ) );
-    return;
-  }
-  if ( !remote ) {
-    error( RTMIDI_ERROR( gettext_noopt( "ALSA has been instructed to open a non-ALSA MIDI port. This doesn't work." ),
-                         Error::INVALID_DEVICE ) );
-    return;
-  }
-
-  try {
-    if ( !data->local.client )
-      data->createPort ( SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
-                         portName );
-    data->setRemote( remote );
-    data->connectPorts( data->local, *remote, true );
 
-    connected_ = true;
-  } catch ( Error& e ) {
-    error ( e );
+  while ( count ) {
+    size_t n = fittingMessages( offsets, count, writeSpace( ) );
+    if ( !n ) {
+      if ( !waitForSpace( offsets[1] - offsets[0] ) )
+        return;
+      // A message that is larger than the buffer is written in pieces.
+      n = std::max( fittingMessages( offsets, count, writeSpace( ) ),
+                    size_t( 1 ) );
+    }
+    if ( !writeBytes( data + offsets[0], offsets[n] - offsets[0] ) )
+      return;
+    offsets += n;
+    count -= n;
   }
 }
-Pointer<PortDescriptor> MidiOutAlsa :: getDescriptor( bool isLocal )
+
+// Only whole messages that fit into the buffer of the driver are
+// written. Afterwards, the poll descriptor waits for room for the
+// next message.
+size_t MidiOutAlsaRaw :: trySendMessages( const unsigned char * data,
+                                          const size_t * offsets,
+                                          size_t count )
 {
-  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
-  try {
-    if ( isLocal ) {
-      if ( data && data->local.client ) {
-        return Pointer<PortDescriptor>(
-                                       new AlsaPortDescriptor( data->local, data->getClientName( ) ) );
-      }
-    } else {
-      if ( data && data->client ) {
-        return Pointer<PortDescriptor>(
-                                       new AlsaPortDescriptor( *data, data->getClientName( ) ) );
-      }
-    }
-  } catch ( Error& e ) {
-    error( e );
+  if ( !handle ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Error sending MIDI message to port." ),
+                         Error::WARNING ) );
+    return 0;
   }
-  return NULL;
+  if ( !count )
+    return 0;
+
+  if ( offsets[1] - offsets[0] > bufferSize ) {
+    error( RTMIDI_ERROR( gettext_noopt( "The MIDI message is too large for the buffer of the raw MIDI device." ),
+                         Error::INVALID_PARAMETER ) );
+    // An error callback has been informed. The message is dropped.
+    return 1;
+  }
+
+  size_t accepted = fittingMessages( offsets, count, writeSpace( ) );
+  if ( accepted
+       && !writeBytes( data + offsets[0], offsets[accepted] - offsets[0] ) )
+    return 0;
+  if ( accepted < count )
+    setAvailMin( offsets[accepted + 1] - offsets[accepted] );
+  return accepted;
 }
-PortList MidiOutAlsa :: getPortList( int capabilities )
+
+int MidiOutAlsaRaw :: getPollDescriptor( )
 {
-  AlsaMidiData * data = static_cast<AlsaMidiData *> ( apiData_ );
-  try {
-    return AlsaPortDescriptor::getPortList( capabilities | PortDescriptor::OUTPUT,
-                                            data->getClientName( ) );
-  } catch ( Error& e ) {
-    return PortList( );
-  }
+  if ( !handle )
+    return -1;
+  struct pollfd poll_fd;
+  if ( snd_rawmidi_poll_descriptors( handle, &poll_fd, 1 ) != 1 )
+    return -1;
+  return poll_fd.fd;
+}
+#undef RTMIDI_CLASSNAME
+
+#define RTMIDI_CLASSNAME "AlsaRawPortDescriptor"
+MidiInApi * AlsaRawPortDescriptor :: getInputApi( unsigned int queueSizeLimit ) const {
+  if ( capabilities & INPUT )
+    return new MidiInAlsaRaw( clientName, queueSizeLimit );
+  else
+    return 0;
+}
+
+MidiOutApi * AlsaRawPortDescriptor :: getOutputApi( ) const {
+  if ( capabilities & OUTPUT )
+    return new MidiOutAlsaRaw( clientName );
+  else
+    return 0;
 }
 #undef RTMIDI_CLASSNAME
 #endif // __LINUX_ALSA__
@@ -4150,6 +6906,7 @@ struct WinMidiData : public WinMMPortDescriptor {
   HMIDIIN inHandle; // Handle to Midi Input Device
   HMIDIOUT outHandle; // Handle to Midi Output Device
   DWORD lastTime;
+  int64_t startTime; // Midi::getMonotonicTime( ) at midiInStart( )
   MidiInApi::MidiMessage message;
   LPMIDIHDR sysexBuffer[RT_SYSEX_BUFFER_COUNT];
   CRITICAL_SECTION _mutex; // [Patrice] see https://groups.google.com/forum/#!topic/mididev/6OUjHutMpEo
@@ -4184,6 +6941,8 @@ struct WinMMCallbacks {
       data->firstMessage = false;
     }
     else apiData->message.timeStamp = ( double ) ( timestamp - apiData->lastTime ) * 0.001;
+    // timestamp counts milliseconds since midiInStart( ).
+    apiData->message.absoluteTime = apiData->startTime + int64_t( timestamp ) * 1000000;
 
     if ( inputStatus == MIM_DATA ) { // Channel or system message
 
@@ -4253,20 +7012,8 @@ struct WinMMCallbacks {
     // Save the time of the last non-filtered message
     apiData->lastTime = timestamp;
 
-    if ( data->userCallback ) {
-      data->userCallback->rtmidi_midi_in( apiData->message.timeStamp, apiData->message.bytes );
-    }
-    else {
-      // As long as we haven't reached our queue size limit, push the message.
-      if ( !data->queue.push( apiData->message ) ) {
-        try {
-          data->error( RTMIDI_ERROR( rtmidi_gettext( "Error: Message queue limit reached." ),
-                                     Error::WARNING ) );
-        } catch ( Error& e ) {
-          // don't bother WinMM with an unhandled exception
-        }
-      }
-    }
+    data->deliverMessage( apiData->message.bytes, apiData->message.timeStamp,
+                          apiData->message.absoluteTime );
 
     // Clear the vector for the next input message.
     apiData->message.bytes.clear( );
@@ -4379,6 +7126,7 @@ void MidiInWinMM :: openPort( unsigned int portNumber, const std::string& /*port
     }
   }
 
+  data->startTime = Midi::getMonotonicTime( );
   result = midiInStart( data->inHandle );
   if ( result != MMSYSERR_NOERROR ) {
     midiInClose( data->inHandle );
@@ -4862,12 +7610,14 @@ RTMIDI_NAMESPACE_END
 #include <jack/jack.h>
 #include <jack/midiport.h>
 #include <jack/ringbuffer.h>
+#include <pthread.h>
 #ifdef HAVE_SEMAPHORE
 #include <semaphore.h>
 #endif
 RTMIDI_NAMESPACE_START
 
 #define JACK_RINGBUFFER_SIZE 16384 // Default size for ringbuffer
+#define JACK_SCHEDULE_SIZE 1024 // Maximum number of held output messages
 
 
 struct JackMidi;
@@ -4877,6 +7627,129 @@ struct JackBackendCallbacks {
   static int ProcessOut( jack_nframes_t nframes, void * arg );
 };
 
+// The header of a message that the process callback passes to the
+// dispatcher thread of an input. The MIDI bytes follow it in the
+// ring buffer.
+struct JackInputEvent {
+  double timeStamp;
+  int64_t absoluteTime;
+  size_t size;
+};
+
+// A ring buffer that is locked into memory, so that the process
+// callback does not cause page faults.
+struct JackRingbuffer {
+  jack_ringbuffer_t * buffer;
+  JackRingbuffer( size_t size )
+    : buffer( jack_ringbuffer_create( size ) )
+  {
+    if ( buffer )
+      jack_ringbuffer_mlock( buffer );
+  }
+  ~JackRingbuffer( )
+  {
+    if ( buffer )
+      jack_ringbuffer_free( buffer );
+  }
+  operator jack_ringbuffer_t * ( ) const { return buffer; }
+};
+
+// The header of a message in the output ring buffers. A time of 0
+// means as soon as possible.
+struct JackOutputEvent {
+  jack_time_t time; // in microseconds of jack_get_time( )
+  size_t size;
+};
+
+// Scheduled output messages that the process callback holds until
+// they are due. The entries are sorted by time, so only the front has
+// to be checked in each period. Messages with the same time keep
+// their order. The entries form a ring, so removing the front only
+// advances head. All memory is allocated by the constructor, so the
+// process callback never allocates.
+class JackOutputSchedule {
+public:
+  struct Entry {
+    jack_time_t time;
+    size_t offset; // position of the bytes in pool
+    size_t size;
+  };
+
+  JackOutputSchedule( size_t capacity, size_t poolSize )
+    : entries( capacity ), pool( poolSize ), scratch( poolSize ),
+      head( 0 ), count( 0 ), used( 0 ) {}
+
+  bool empty( ) const { return !count; }
+  const Entry& front( ) const { return entries[head]; }
+  const unsigned char * data( const Entry& entry ) const {
+    return pool.data( ) + entry.offset;
+  }
+
+  // Add an entry and return the place for its bytes, or 0 if there
+  // is no room.
+  unsigned char * insert( jack_time_t time, size_t size ) {
+    if ( count == entries.size( ) )
+      return 0;
+    if ( used + size > pool.size( ) ) {
+      compact( );
+      if ( used + size > pool.size( ) )
+        return 0;
+    }
+    // Usually, messages arrive in the order of their times and
+    // nothing has to be moved.
+    size_t i = count;
+    while ( i && at( i - 1 ).time > time ) {
+      at( i ) = at( i - 1 );
+      i--;
+    }
+    Entry& entry = at( i );
+    entry.time = time;
+    entry.offset = used;
+    entry.size = size;
+    count++;
+    unsigned char * result = pool.data( ) + used;
+    used += size;
+    return result;
+  }
+
+  void pop( ) {
+    if ( ++head == entries.size( ) )
+      head = 0;
+    if ( !--count ) {
+      head = 0;
+      used = 0;
+    }
+  }
+
+protected:
+  // The entry at position i of the sorted sequence.
+  Entry& at( size_t i ) {
+    i += head;
+    return entries[i < entries.size( ) ? i : i - entries.size( )];
+  }
+
+  // Move the bytes of all entries to the beginning of the pool.
+  void compact( ) {
+    size_t position = 0;
+    for ( size_t i = 0; i < count; i++ ) {
+      Entry& entry = at( i );
+      memcpy( scratch.data( ) + position, pool.data( ) + entry.offset,
+              entry.size );
+      entry.offset = position;
+      position += entry.size;
+    }
+    pool.swap( scratch );
+    used = position;
+  }
+
+  std::vector<Entry> entries;
+  std::vector<unsigned char> pool;
+  std::vector<unsigned char> scratch;
+  size_t head; // index of the front entry
+  size_t count;
+  size_t used;
+};
+
 
 #define RTMIDI_CLASSNAME "JackSequencer"
 template <int locking=1>
@@ -5282,6 +8155,7 @@ struct JackMidi : public JackPortDescriptor {
   jack_port_t * local;
   jack_ringbuffer_t * buffSize;
   jack_ringbuffer_t * buffMessage;
+  JackOutputSchedule * schedule;
   jack_time_t lastTime;
 #ifdef HAVE_SEMAPHORE
   sem_t sem_cleanup;
@@ -5308,6 +8182,7 @@ struct JackMidi : public JackPortDescriptor {
       local( 0 ),
       buffSize( 0 ),
       buffMessage( 0 ),
+      schedule( 0 ),
       lastTime( 0 ),
       rtMidiIn( inputData_ ),
       seq( new NonLockingJackSequencer( clientName, *this ) )
@@ -5332,6 +8207,8 @@ struct JackMidi : public JackPortDescriptor {
       local( 0 ),
       buffSize( jack_ringbuffer_create( JACK_RINGBUFFER_SIZE ) ),
       buffMessage( jack_ringbuffer_create( JACK_RINGBUFFER_SIZE ) ),
+      schedule( new JackOutputSchedule( JACK_SCHEDULE_SIZE,
+                                        JACK_RINGBUFFER_SIZE ) ),
       lastTime( 0 ),
       rtMidiIn( ),
       seq( new NonLockingJackSequencer( clientName, *this ) )
@@ -5366,6 +8243,7 @@ struct JackMidi : public JackPortDescriptor {
       jack_ringbuffer_free( buffMessage );
       buffMessage = 0;
     }
+    delete schedule;
   }
 
   void init( bool isinput ) {
@@ -5595,8 +8473,29 @@ public:
   std::string getPortName( unsigned int portNumber );
 
 public:
+  // Messages from the process callback. It is declared before midi,
+  // so it outlives the JACK client.
+  JackRingbuffer events;
   JackMidi midi;
 
+  // The dispatcher thread passes the messages from events to the
+  // callback or the queue. It holds the mutex except while it waits
+  // for the condition.
+  pthread_t dispatcher;
+  bool dispatcherRunning;
+  pthread_mutex_t dispatchMutex;
+  pthread_cond_t dispatchCondition;
+  std::atomic_bool terminate;
+  // Buffer for the message that is being dispatched.
+  std::vector<unsigned char> dispatchBuffer;
+  // Number of overruns that have been reported.
+  size_t reportedOverruns;
+
+  bool startDispatcher( );
+  void stopDispatcher( );
+  void dispatchEvents( );
+  static void * dispatchHandler( void * ptr ) throw( );
+
   //void connect( void );
   //void initialize( const std::string& clientName );
 };
@@ -5619,10 +8518,15 @@ public:
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
   void sendMessage( const unsigned char * message, size_t size );
+  void scheduleMessage( const unsigned char * message, size_t size,
+                        int64_t time );
 
 public:
   JackMidi * midi;
 
+  void queueMessage( const unsigned char * message, size_t size,
+                     jack_time_t time );
+
   //void connect( void );
   void initialize( const std::string& clientName );
 };
@@ -5644,45 +8548,73 @@ int JackBackendCallbacks :: ProcessIn( jack_nframes_t nframes, void * arg )
   // Is port created?
   if ( jData->local == NULL ) return 0;
   void * buff = jack_port_get_buffer( jData->local, nframes );
+  // Only the zero-copy interface can be served without allocating
+  // memory. Queues and vector based callbacks use the dispatcher.
+  bool realtime = rtData->realtimeCallback && rtData->viewCallback;
+
+  // The events are placed at their frames in the current period like
+  // the audio data, so they may lie up to one period ahead of
+  // Midi::getMonotonicTime( ). The offset between the clocks of JACK
+  // and Midi::getMonotonicTime( ) is taken once per period.
+  jack_client_t * client = *( jData->seq );
+  jack_nframes_t periodFrame = jack_last_frame_time( client );
+  int64_t clockOffset = Midi::getMonotonicTime( )
+    - int64_t( jack_get_time( ) ) * 1000;
 
   // We have midi events in buffer
   int evCount = jack_midi_get_event_count( buff );
   for ( int j = 0; j < evCount; j++ ) {
-    MidiInApi::MidiMessage message;
-    message.bytes.clear( );
-
+    double timeStamp;
+    int64_t absoluteTime;
     jack_midi_event_get( &event, buff, j );
-    message.bytes.reserve( event.size );
-
-    for ( unsigned int i = 0; i < event.size; i++ )
-      message.bytes.push_back( event.buffer[i] );
 
     // Compute the delta time.
-    time = jack_get_time( );
+    time = jack_frames_to_time( client, periodFrame + event.time );
+    absoluteTime = int64_t( time ) * 1000 + clockOffset;
     if ( rtData->firstMessage == true ) {
-      message.timeStamp = 0.0;
+      timeStamp = 0.0;
       rtData->firstMessage = false;
-    } else
-      message.timeStamp = ( time - jData->lastTime ) * 0.000001;
+    } else {
+      // jack_time_t is unsigned. The clock can step back when
+      // jack_frames_to_time( ) refines its estimate.
+      int64_t delta = int64_t( time ) - int64_t( jData->lastTime );
+      timeStamp = std::max( delta, int64_t( 0 ) ) * 0.000001;
+    }
 
     jData->lastTime = time;
 
-    if ( !rtData->continueSysex ) {
-      if ( rtData->userCallback ) {
-        rtData->userCallback->rtmidi_midi_in( message.timeStamp, message.bytes );
-      }
-      else {
-        // As long as we haven't reached our queue size limit, push the message.
-        if ( !rtData->queue.push( message ) ) {
-          try {
-            rtData->error( RTMIDI_ERROR( rtmidi_gettext( "Error: Message queue limit reached." ),
-                                         Error::WARNING ) );
-          } catch ( Error& e ) {
-            // don't bother JACK with an unhandled exception
-          }
-        }
-      }
+    if ( rtData->continueSysex )
+      continue;
+
+    // The message is passed directly from the JACK buffer.
+    if ( realtime ) {
+      rtData->deliverMessage( event.buffer, event.size, timeStamp, absoluteTime );
+      continue;
+    }
+
+    // Otherwise it is copied for the dispatcher. Memory allocation,
+    // locks and error messages are left to the dispatcher, too.
+    JackInputEvent header = { timeStamp, absoluteTime, event.size };
+    if ( jack_ringbuffer_write_space( rtData->events )
+         < sizeof( header ) + event.size ) {
+      rtData->overruns++;
+      continue;
     }
+    jack_ringbuffer_write( rtData->events,
+                           ( const char * ) &header,
+                           sizeof( header ) );
+    jack_ringbuffer_write( rtData->events,
+                           ( const char * ) event.buffer,
+                           event.size );
+  }
+
+  // Wake the dispatcher if it is waiting. Otherwise it is busy, and
+  // we try again with the next period, unless it has emptied the
+  // buffer in the meantime.
+  if ( !realtime && jack_ringbuffer_read_space( rtData->events )
+       && !pthread_mutex_trylock( &rtData->dispatchMutex ) ) {
+    pthread_cond_signal( &rtData->dispatchCondition );
+    pthread_mutex_unlock( &rtData->dispatchMutex );
   }
 
   return 0;
@@ -5693,7 +8625,7 @@ int JackBackendCallbacks :: ProcessOut( jack_nframes_t nframes, void * arg )
 {
   JackMidi * data = static_cast<JackMidi*>(arg);
   jack_midi_data_t * midiData;
-  int space;
+  JackOutputEvent header;
 
   // Is port created?
   if ( data->local == NULL ) return 0;
@@ -5701,16 +8633,39 @@ int JackBackendCallbacks :: ProcessOut( jack_nframes_t nframes, void * arg )
   void * buff = jack_port_get_buffer( data->local, nframes );
   if ( buff != NULL ) {
     jack_midi_clear_buffer( buff );
+    jack_client_t * client = *( data->seq );
+    jack_nframes_t periodFrame = jack_last_frame_time( client );
+
+    // Unscheduled messages go to the first frame. Scheduled ones are
+    // held until they are due. If there is no room to hold them, they
+    // stay in the ring buffer until the next period.
+    while ( jack_ringbuffer_peek( data->buffSize,
+                                  (char *)(&header),
+                                  sizeof( header ) ) == sizeof( header ) ) {
+      if ( header.time ) {
+        unsigned char * target = data->schedule->insert( header.time, header.size );
+        if ( !target ) break;
+        jack_ringbuffer_read( data->buffMessage, (char *)(target), header.size );
+      } else if ( ( midiData = jack_midi_event_reserve( buff, 0, header.size ) ) ) {
+        jack_ringbuffer_read( data->buffMessage, (char *)(midiData), header.size );
+      } else {
+        // The port buffer is full.
+        jack_ringbuffer_read_advance( data->buffMessage, header.size );
+      }
+      jack_ringbuffer_read_advance( data->buffSize, sizeof( header ) );
+    }
 
-    while ( jack_ringbuffer_read_space( data->buffSize ) > 0 ) {
-      jack_ringbuffer_read( data->buffSize,
-                            (char *)(&space),
-                            (size_t) sizeof( space ) );
-      midiData = jack_midi_event_reserve( buff, 0, space );
-
-      jack_ringbuffer_read( data->buffMessage,
-                            (char *)(midiData),
-                            (size_t) space );
+    // Place the messages that are due in this period at their
+    // frames. Late ones go to the first frame.
+    while ( !data->schedule->empty( ) ) {
+      const JackOutputSchedule::Entry& entry = data->schedule->front( );
+      int32_t frame = int32_t( jack_time_to_frames( client, entry.time ) - periodFrame );
+      if ( frame >= int32_t( nframes ) ) break;
+      midiData = jack_midi_event_reserve( buff, std::max( frame, int32_t( 0 ) ),
+                                          entry.size );
+      if ( !midiData ) break;
+      memcpy( midiData, data->schedule->data( entry ), entry.size );
+      data->schedule->pop( );
     }
   }
 
@@ -5738,8 +8693,16 @@ MidiOutApi * JackPortDescriptor :: getOutputApi( ) const {
 #define RTMIDI_CLASSNAME "MidiInJack"
 MidiInJack :: MidiInJack( const std::string& clientName, unsigned int queueSizeLimit )
   : MidiInApi( queueSizeLimit ),
-    midi( clientName, this )
-{
+    events( JACK_RINGBUFFER_SIZE ),
+    midi( clientName, this ),
+    dispatcherRunning( false ),
+    terminate( false ),
+    reportedOverruns( 0 )
+{
+  pthread_mutex_init( &dispatchMutex, NULL );
+  pthread_cond_init( &dispatchCondition, NULL );
+  // avoid memory allocation in the JACK process callback
+  callbackBuffer.reserve( 1024 );
   midi.init( true );
 }
 
@@ -5772,6 +8735,94 @@ MidiInJack :: ~MidiInJack( )
   } catch ( Error& e ) {
     e.printMessage( std::cerr );
   }
+  stopDispatcher( );
+  pthread_cond_destroy( &dispatchCondition );
+  pthread_mutex_destroy( &dispatchMutex );
+}
+
+// Start the dispatcher thread unless it is already running.
+bool MidiInJack :: startDispatcher( )
+{
+  if ( dispatcherRunning )
+    return true;
+  if ( !events ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Could not allocate the JACK input buffer." ),
+                         Error::MEMORY_ERROR ) );
+    return false;
+  }
+  if ( pthread_create( &dispatcher, NULL, dispatchHandler, this ) ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Error starting MIDI input thread!" ),
+                         Error::THREAD_ERROR ) );
+    return false;
+  }
+  dispatcherRunning = true;
+  return true;
+}
+
+// Terminate the dispatcher thread. Messages that it has not
+// delivered yet are dropped.
+void MidiInJack :: stopDispatcher( )
+{
+  if ( !dispatcherRunning )
+    return;
+  terminate = true;
+  pthread_mutex_lock( &dispatchMutex );
+  pthread_cond_signal( &dispatchCondition );
+  pthread_mutex_unlock( &dispatchMutex );
+  pthread_join( dispatcher, NULL );
+  dispatcherRunning = false;
+}
+
+// Deliver the complete messages in the ring buffer. The process
+// callback writes the header before the bytes, so a message is
+// complete when both are available.
+void MidiInJack :: dispatchEvents( )
+{
+  size_t lost = overruns;
+  if ( lost != reportedOverruns ) {
+    reportedOverruns = lost;
+    try {
+      error( RTMIDI_ERROR( rtmidi_gettext( "MIDI input buffer overrun." ),
+                           Error::WARNING ) );
+    } catch ( Error& e ) {
+      // don't bother the dispatcher with an unhandled exception
+    }
+  }
+
+  JackInputEvent header;
+  while ( jack_ringbuffer_peek( events, ( char * ) &header, sizeof( header ) )
+          == sizeof( header )
+          && jack_ringbuffer_read_space( events ) >= sizeof( header ) + header.size ) {
+    jack_ringbuffer_read_advance( events, sizeof( header ) );
+    try {
+      dispatchBuffer.resize( header.size );
+    } catch ( std::bad_alloc& e ) {
+      jack_ringbuffer_read_advance( events, header.size );
+      try {
+        error( RTMIDI_ERROR( rtmidi_gettext( "Error resizing buffer memory." ),
+                             Error::WARNING ) );
+      } catch ( Error& e ) {
+        // don't bother the dispatcher with an unhandled exception
+      }
+      continue;
+    }
+    jack_ringbuffer_read( events, ( char * ) dispatchBuffer.data( ), header.size );
+    deliverMessage( dispatchBuffer.data( ), header.size,
+                    header.timeStamp, header.absoluteTime );
+  }
+}
+
+// static function:
+void * MidiInJack :: dispatchHandler( void * ptr ) throw( )
+{
+  MidiInJack * data = static_cast<MidiInJack *> ( ptr );
+  pthread_mutex_lock( &data->dispatchMutex );
+  while ( !data->terminate ) {
+    data->dispatchEvents( );
+    pthread_cond_wait( &data->dispatchCondition, &data->dispatchMutex );
+  }
+  pthread_mutex_unlock( &data->dispatchMutex );
+  return 0;
 }
 
 void MidiInJack :: openPort( unsigned int portNumber, const std::string& portName )
@@ -5789,6 +8840,9 @@ void MidiInJack :: openPort( unsigned int portNumber, const std::string& portNam
 
 void MidiInJack :: openVirtualPort( const std::string& portName )
 {
+  // The process callback ignores the input as long as there is no port.
+  if ( !startDispatcher( ) )
+    return;
   try {
     midi.ensureOpen( JackPortIsInput,
                      portName );
@@ -6068,13 +9122,40 @@ void MidiOutJack :: setPortName( const std::string& portName )
 
 void MidiOutJack :: sendMessage( const unsigned char * message, size_t size )
 {
-  int nBytes = size;
+  queueMessage( message, size, 0 );
+}
+
+void MidiOutJack :: scheduleMessage( const unsigned char * message,
+                                     size_t size,
+                                     int64_t time )
+{
+  // Convert the time into the clock of JACK. 0 would mean as soon as
+  // possible, which is the same for any time in the past.
+  int64_t jackTime = ( time - Midi::getMonotonicTime( ) ) / 1000
+    + int64_t( jack_get_time( ) );
+  queueMessage( message, size, std::max( jackTime, int64_t( 1 ) ) );
+}
+
+// Pass a message to the process callback. The header is written after
+// the bytes, so the callback never sees an incomplete message.
+void MidiOutJack :: queueMessage( const unsigned char * message,
+                                  size_t size,
+                                  jack_time_t time )
+{
   if ( !midi ) return;
 
+  JackOutputEvent header = { time, size };
+  if ( jack_ringbuffer_write_space( midi->buffMessage ) < size
+       || jack_ringbuffer_write_space( midi->buffSize ) < sizeof( header ) ) {
+    error( RTMIDI_ERROR( gettext_noopt( "The JACK output buffer is full. The message has been dropped." ),
+                         Error::WARNING ) );
+    return;
+  }
+
   // Write full message to buffer
   jack_ringbuffer_write( midi->buffMessage, (const char *)( message ),
-                         nBytes );
-  jack_ringbuffer_write( midi->buffSize, ( char * ) &nBytes, sizeof( nBytes ) );
+                         size );
+  jack_ringbuffer_write( midi->buffSize, (const char *)( &header ), sizeof( header ) );
 }
 #undef RTMIDI_CLASSNAME
 #endif // __UNIX_JACK__
@@ -6159,6 +9240,41 @@ std::string Midi :: getVersion( void ) throw( )
   return std::string( RTMIDI_VERSION );
 }
 
+int64_t Midi :: getMonotonicTime( ) throw( )
+{
+  // The conversions split the counter into seconds and the rest, so
+  // they neither overflow nor lose precision.
+#if defined( _WIN32 ) && !defined( __CYGWIN__ )
+  static LARGE_INTEGER frequency = { { 0, 0 } };
+  LARGE_INTEGER counter;
+  if ( !frequency.QuadPart )
+    QueryPerformanceFrequency( &frequency );
+  QueryPerformanceCounter( &counter );
+  return ( counter.QuadPart / frequency.QuadPart ) * INT64_C( 1000000000 )
+    + ( counter.QuadPart % frequency.QuadPart ) * INT64_C( 1000000000 ) / frequency.QuadPart;
+#elif defined( __APPLE__ )
+  static mach_timebase_info_data_t timebase = { 0, 0 };
+  if ( !timebase.denom )
+    mach_timebase_info( &timebase );
+  uint64_t time = mach_absolute_time( );
+  return ( time / timebase.denom ) * timebase.numer
+    + ( time % timebase.denom ) * timebase.numer / timebase.denom;
+#else
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return int64_t( ts.tv_sec ) * INT64_C( 1000000000 ) + ts.tv_nsec;
+#endif
+}
+
+size_t Midi :: getUmpPacketSize( uint32_t word ) throw( )
+{
+  // Number of words by message type.
+  static const unsigned char sizes[16] = {
+    1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4
+  };
+  return sizes[word >> 28];
+}
+
 
 // This is a compile-time check that rtmidi_num_api_names == RtMidi::NUM_APIS.
 // If the build breaks here, check that they match.
@@ -6227,6 +9343,27 @@ ApiType Midi :: getCompiledApiByName( const std::string& name, bool preferSystem
   return UNSPECIFIED;
 }
 
+std::atomic<bool> Midi :: sharedClient( false );
+
+void Midi :: setSharedClient( bool shared )
+{
+  sharedClient = shared;
+}
+
+#define RTMIDI_CLASSNAME "Midi"
+RoutePointer Midi :: createRoute( const PortDescriptor& source,
+                                  const PortDescriptor& destination,
+                                  int flags )
+{
+  Route * route = source.createRoute( destination, flags );
+  if ( !route ) {
+    throw RTMIDI_ERROR( gettext_noopt( "This API does not support routes between ports." ),
+                        Error::INVALID_DEVICE );
+  }
+  return RoutePointer( route );
+}
+#undef RTMIDI_CLASSNAME
+
 
 
 
@@ -6273,6 +9410,11 @@ void MidiIn :: openMidiApi( ApiType api )
     case rtmidi::LINUX_ALSA:
 #if defined( __LINUX_ALSA__ )
       rtapi_ = new MidiInAlsa( clientName, queueSizeLimit );
+#endif
+      break;
+    case rtmidi::LINUX_ALSA_RAW:
+#if defined( __LINUX_ALSA__ )
+      rtapi_ = new MidiInAlsaRaw( clientName, queueSizeLimit );
 #endif
       break;
     case rtmidi::WINDOWS_MM:
@@ -6302,6 +9444,12 @@ void MidiIn :: openMidiApi( ApiType api )
 }
 
 MidiApiList MidiIn :: queryApis;
+std::atomic<unsigned int> MidiIn :: sharedInputThreads( 0 );
+
+void MidiIn :: setSharedInputThreads( unsigned int threads )
+{
+  sharedInputThreads = threads;
+}
 
 RTMIDI_DLL_PUBLIC MidiIn :: MidiIn( ApiType api,
                                     const std::string& clientName,
@@ -6319,6 +9467,9 @@ RTMIDI_DLL_PUBLIC MidiIn :: MidiIn( ApiType api,
     std::vector< ApiType > apis;
     getCompiledApi( apis );
     for ( unsigned int i=0; i<apis.size( ); i++ ) {
+      // Its devices are already listed by the ALSA sequencer.
+      if ( apis[i] == rtmidi::LINUX_ALSA_RAW )
+        continue;
       try {
         openMidiApi( apis[i] );
         if ( rtapi_ ) {
@@ -6350,6 +9501,8 @@ RTMIDI_DLL_PUBLIC MidiIn :: MidiIn( ApiType api,
   std::vector< ApiType > apis;
   getCompiledApi( apis );
   for ( unsigned int i=0; i<apis.size( ); i++ ) {
+    if ( apis[i] == rtmidi::LINUX_ALSA_RAW )
+      continue;
     openMidiApi( apis[i] );
     if ( rtapi_ && rtapi_->getPortCount( ) ) break;
   }
@@ -6388,6 +9541,11 @@ void MidiOut :: openMidiApi( ApiType api )
     case rtmidi::LINUX_ALSA:
 #if defined( __LINUX_ALSA__ )
       rtapi_ = new MidiOutAlsa( clientName );
+#endif
+      break;
+    case rtmidi::LINUX_ALSA_RAW:
+#if defined( __LINUX_ALSA__ )
+      rtapi_ = new MidiOutAlsaRaw( clientName );
 #endif
       break;
     case rtmidi::WINDOWS_MM:
@@ -6432,6 +9590,9 @@ RTMIDI_DLL_PUBLIC MidiOut :: MidiOut( ApiType api, const std::string& clientName
     std::vector< ApiType > apis;
     getCompiledApi( apis );
     for ( unsigned int i=0; i<apis.size( ); i++ ) {
+      // Its devices are already listed by the ALSA sequencer.
+      if ( apis[i] == rtmidi::LINUX_ALSA_RAW )
+        continue;
       try {
         openMidiApi( apis[i] );
         if ( rtapi_ ) {
@@ -6462,6 +9623,8 @@ RTMIDI_DLL_PUBLIC MidiOut :: MidiOut( ApiType api, const std::string& clientName
   std::vector< ApiType > apis;
   getCompiledApi( apis );
   for ( unsigned int i=0; i<apis.size( ); i++ ) {
+    if ( apis[i] == rtmidi::LINUX_ALSA_RAW )
+      continue;
     openMidiApi( apis[i] );
     if ( rtapi_ && rtapi_->getPortCount( ) ) break;
   }
@@ -6500,6 +9663,28 @@ void MidiApi :: setErrorCallback( ErrorInterface * callback ) {
   errorCallback_ = callback;
 }
 
+#define RTMIDI_CLASSNAME "MidiApi"
+void MidiApi :: setPortChangeCallback( PortChangeInterface * callback )
+{
+  if ( !callback ) return;
+  error( RTMIDI_ERROR( gettext_noopt( "This API does not support port change notifications." ),
+                       Error::WARNING ) );
+}
+
+void MidiApi :: setBufferSizes( const BufferSizes& )
+{
+  error( RTMIDI_ERROR( gettext_noopt( "This API does not support setting buffer sizes." ),
+                       Error::WARNING ) );
+}
+
+void MidiApi :: setProtocol( MidiProtocol protocol )
+{
+  if ( protocol == MIDI_BYTE_STREAM ) return;
+  error( RTMIDI_ERROR( gettext_noopt( "This API does not support Universal MIDI Packets." ),
+                       Error::WARNING ) );
+}
+#undef RTMIDI_CLASSNAME
+
 
 void MidiApi :: error( Error e )
 {
@@ -6537,22 +9722,23 @@ void MidiApi :: error( Error e )
 
 #define RTMIDI_CLASSNAME "MidiInApi"
 MidiInApi :: MidiInApi( unsigned int queueSizeLimit )
-  : MidiApi( ), ignoreFlags( 7 ), doInput( false ), firstMessage( true ),
+  : MidiApi( ), ignoreFlags( 7 ), maxSysexSize( 0 ),
+    overruns( 0 ),
+    realtimeCallback( false ),
+    doInput( false ), firstMessage( true ),
     userCallback( 0 ),
+    viewCallback( 0 ),
+    callbackTag( 0 ),
     continueSysex( false )
 {
   // Allocate the MIDI queue.
-  queue.ringSize = queueSizeLimit;
-  if ( queue.ringSize > 0 )
-    queue.ring = new MidiMessage[ queue.ringSize ];
+  queue.allocate( queueSizeLimit );
 }
 
 MidiInApi :: ~MidiInApi( void )
 {
   if ( userCallback )
     userCallback->delete_me( );
-  // Delete the MIDI queue.
-  if ( queue.ringSize > 0 ) delete [] queue.ring;
 }
 
 void MidiInApi :: setCallback( MidiCallback callback, void * userData )
@@ -6570,9 +9756,10 @@ void MidiInApi :: setCallback( MidiCallback callback, void * userData )
   }
 
   userCallback = new CompatibilityMidiInterface( callback, userData );
+  viewCallback = 0;
 }
 
-void MidiInApi :: setCallback( MidiInterface * callback )
+void MidiInApi :: setCallback( MidiInterface * callback, void * tag )
 {
   if ( userCallback ) {
     error( RTMIDI_ERROR( gettext_noopt( "A callback function is already set." ),
@@ -6587,6 +9774,8 @@ void MidiInApi :: setCallback( MidiInterface * callback )
   }
 
   userCallback = callback;
+  viewCallback = dynamic_cast<MidiViewInterface *>( callback );
+  callbackTag = tag;
 }
 
 void MidiInApi :: cancelCallback( )
@@ -6599,6 +9788,8 @@ void MidiInApi :: cancelCallback( )
 
   userCallback->delete_me( );
   userCallback = 0;
+  viewCallback = 0;
+  callbackTag = 0;
 }
 
 void MidiInApi :: ignoreTypes( bool midiSysex, bool midiTime, bool midiSense )
@@ -6626,62 +9817,447 @@ double MidiInApi :: getMessage( std::vector<unsigned char>& message )
   return timeStamp;
 }
 
+double MidiInApi :: getMessage( std::vector<unsigned char>& message,
+                                int64_t& absoluteTime )
+{
+  message.clear( );
+
+  if ( userCallback ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Returning an empty MIDI message as all input is handled by a callback function." ),
+                         Error::WARNING ) );
+    return 0.0;
+  }
+
+  double timeStamp;
+  if ( !queue.pop( message, timeStamp, &absoluteTime ) )
+    return 0.0;
+
+  return timeStamp;
+}
+
+size_t MidiInApi :: getMessages( unsigned char * data, size_t dataSize,
+                                 size_t * offsets, double * timeStamps,
+                                 size_t maxMessages,
+                                 int64_t * absoluteTimes )
+{
+  if ( offsets ) offsets[0] = 0;
+
+  if ( userCallback ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Returning no MIDI messages as all input is handled by a callback function." ),
+                         Error::WARNING ) );
+    return 0;
+  }
+
+  if ( !data || !offsets ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Passed NULL pointer." ),
+                         Error::INVALID_PARAMETER ) );
+    return 0;
+  }
+
+  return queue.pop( data, dataSize, offsets, timeStamps, maxMessages,
+                    absoluteTimes );
+}
+
+size_t MidiInApi :: getNextMessageSize( )
+{
+  if ( userCallback ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Returning no MIDI messages as all input is handled by a callback function." ),
+                         Error::WARNING ) );
+    return 0;
+  }
+
+  return queue.frontSize( );
+}
+
+void MidiInApi :: deliverMessage( const unsigned char * data,
+                                  size_t size,
+                                  double timeStamp,
+                                  int64_t absoluteTime )
+{
+  if ( viewCallback ) {
+    MidiMessageView view = { data, size, timeStamp, absoluteTime, callbackTag };
+    viewCallback->rtmidi_midi_in( view );
+  } else if ( userCallback ) {
+    callbackBuffer.assign( data, data + size );
+    userCallback->rtmidi_midi_in( timeStamp, callbackBuffer );
+  } else {
+    // As long as we haven't reached our queue size limit, push the message.
+    if ( !queue.push( data, size, timeStamp, absoluteTime ) ) {
+      try {
+        error( RTMIDI_ERROR( rtmidi_gettext( "Error: Message queue limit reached." ),
+                             Error::WARNING ) );
+      } catch ( Error& e ) {
+        // don't bother the backend with an unhandled exception
+      }
+    }
+  }
+}
+
+void MidiInApi :: deliverMessage( std::vector<unsigned char>& data,
+                                  double timeStamp,
+                                  int64_t absoluteTime )
+{
+  // Vector based callbacks get the vector without copying it.
+  if ( userCallback && !viewCallback )
+    userCallback->rtmidi_midi_in( timeStamp, data );
+  else
+    deliverMessage( data.data( ), data.size( ), timeStamp, absoluteTime );
+}
+
+bool MidiInApi :: waitForMessage( int timeout )
+{
+  if ( userCallback ) {
+    error( RTMIDI_ERROR( gettext_noopt( "Not waiting for MIDI messages as all input is handled by a callback function." ),
+                         Error::WARNING ) );
+    return false;
+  }
+
+  if ( !queue.enableNotification( ) ) {
+    error( RTMIDI_ERROR1( gettext_noopt( "Could not create a notification for the input queue.\nThe system reports:\n%s" ),
+                          Error::WARNING,
+                          strerror( errno ) ) );
+    return false;
+  }
+
+  return queue.wait( timeout );
+}
+
+int MidiInApi :: getPollDescriptor( )
+{
+  if ( !queue.enableNotification( ) ) {
+    error( RTMIDI_ERROR1( gettext_noopt( "Could not create a notification for the input queue.\nThe system reports:\n%s" ),
+                          Error::WARNING,
+                          strerror( errno ) ) );
+    return -1;
+  }
+
+  return queue.notifyFds[0];
+}
+
+MidiInApi :: MidiQueue :: ~MidiQueue( )
+{
+  // Release messages that have not been read.
+  if ( ring ) {
+    unsigned int _back = back.load( std::memory_order_acquire );
+    for ( unsigned int i = front.load( std::memory_order_relaxed ); i != _back; ++i )
+      delete [] ring[i & mask].overflow;
+  }
+  delete [] ring;
+  delete [] pool;
+
+#if defined( _WIN32 ) && !defined( __CYGWIN__ )
+  if ( notifyEvent ) CloseHandle( ( HANDLE ) notifyEvent );
+#else
+  if ( notifyFds[1] >= 0 && notifyFds[1] != notifyFds[0] ) close( notifyFds[1] );
+  if ( notifyFds[0] >= 0 ) close( notifyFds[0] );
+#endif
+}
+
+void MidiInApi :: MidiQueue :: allocate( unsigned int queueSizeLimit,
+                                         size_t sysexPoolSize )
+{
+  // The ring size is rounded up to the next power of two so that the
+  // indices can be reduced by a mask, while the limit keeps the number
+  // of queued messages at the requested size. Sizes above the largest
+  // power of two cannot be rounded up.
+  const unsigned int maxRingSize = ~( ~0u >> 1 );
+  const size_t maxPoolSize = ~( ~size_t( 0 ) >> 1 );
+  if ( queueSizeLimit > maxRingSize || sysexPoolSize > maxPoolSize )
+    throw RTMIDI_ERROR( gettext_noopt( "The requested input queue size is too large." ),
+                        Error::MEMORY_ERROR );
+  limit = queueSizeLimit;
+  ringSize = 0;
+  mask = 0;
+  ring = 0;
+  poolSize = 0;
+  pool = 0;
+  if ( limit == 0 )
+    return;
+  ringSize = 1;
+  while ( ringSize < limit )
+    ringSize <<= 1;
+  mask = ringSize - 1;
+  ring = new QueuedMessage[ ringSize ];
+
+  if ( sysexPoolSize == 0 )
+    return;
+  poolSize = 1;
+  while ( poolSize < sysexPoolSize )
+    poolSize <<= 1;
+  pool = new unsigned char[ poolSize ];
+}
+
 unsigned int MidiInApi :: MidiQueue :: size( unsigned int * __back,
                                              unsigned int * __front )
 {
   // Access back/front members exactly once and make stack copies for
-  // size calculation
-  unsigned int _back = back, _front = front, _size;
-  if ( _back >= _front )
-    _size = _back - _front;
-  else
-    _size = ringSize - _front + _back;
+  // size calculation. The acquire loads make the message data written
+  // before the corresponding release store visible to this thread.
+  unsigned int _back = back.load( std::memory_order_acquire );
+  unsigned int _front = front.load( std::memory_order_acquire );
 
   // Return copies of back/front so no new and unsynchronized accesses
   // to member variables are needed.
   if ( __back ) *__back = _back;
   if ( __front ) *__front = _front;
-  return _size;
+  return _back - _front;
 }
 
 // As long as we haven't reached our queue size limit, push the message.
-bool MidiInApi :: MidiQueue :: push( const MidiInApi :: MidiMessage& msg )
+bool MidiInApi :: MidiQueue :: push( const unsigned char * data,
+                                     size_t size,
+                                     double timeStamp,
+                                     int64_t absoluteTime )
+{
+  // Only this thread writes back, so a relaxed load is sufficient. The
+  // acquire on front pairs with the release in pop( ) and ensures that
+  // the consumer has finished reading the slot we are going to reuse.
+  unsigned int _back = back.load( std::memory_order_relaxed );
+  unsigned int _front = front.load( std::memory_order_acquire );
+
+  if ( _back - _front >= limit )
+    return false;
+
+  QueuedMessage & slot = ring[_back & mask];
+  slot.timeStamp = timeStamp;
+  slot.absoluteTime = absoluteTime;
+  slot.size = size;
+  slot.overflow = 0;
+  if ( size <= QueuedMessage::inlineSize ) {
+    if ( size )
+      memcpy( slot.bytes, data, size );
+  } else if ( poolBack + size - poolFront.load( std::memory_order_acquire ) <= poolSize ) {
+    // The message may wrap around the end of the pool.
+    size_t offset = poolBack & ( poolSize - 1 );
+    size_t first = std::min( size, poolSize - offset );
+    memcpy( pool + offset, data, first );
+    memcpy( pool, data + first, size - first );
+    poolBack += size;
+  } else {
+    // The pool is too small. This is the only case where we have to
+    // allocate memory.
+    slot.overflow = new ( std::nothrow ) unsigned char[ size ];
+    if ( !slot.overflow )
+      return false;
+    memcpy( slot.overflow, data, size );
+  }
+
+  back.store( _back + 1, std::memory_order_release );
+
+  // Wake up the consumer if the queue has been empty before. The fence
+  // pairs with the one in loadBack( ) and wait( ): Either the
+  // consumer sees the new message, or we see that it has read all
+  // previous messages.
+  std::atomic_thread_fence( std::memory_order_seq_cst );
+  if ( notifying.load( std::memory_order_acquire )
+       && front.load( std::memory_order_relaxed ) == _back )
+    notify( );
+  return true;
+}
+
+// Load the back index for the consumer. If the queue is empty, the
+// notification is reset, so that a poll( ) on it blocks until the
+// next message arrives.
+unsigned int MidiInApi :: MidiQueue :: loadBack( unsigned int _front )
 {
-  // Local stack copies of front/back
-  unsigned int _back, _front, _size;
+  unsigned int _back = back.load( std::memory_order_acquire );
+  if ( _back != _front || !notifying.load( std::memory_order_relaxed ) )
+    return _back;
 
-  // Get back/front indexes exactly once and calculate current size
-  _size = size( &_back, &_front );
+  // A message that arrives after the reset will signal again.
+  resetNotification( );
+  std::atomic_thread_fence( std::memory_order_seq_cst );
+  return back.load( std::memory_order_acquire );
+}
 
-  if ( _size < ringSize-1 )
-    {
-      ring[_back] = msg;
-      back = ( back+1 )%ringSize;
+// Create the notification. This is done by the consumer.
+bool MidiInApi :: MidiQueue :: enableNotification( )
+{
+  if ( notifying.load( std::memory_order_relaxed ) )
+    return true;
+
+#if defined( _WIN32 ) && !defined( __CYGWIN__ )
+  // auto-reset event
+  notifyEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+  if ( !notifyEvent )
+    return false;
+#elif defined( __linux__ )
+  notifyFds[0] = notifyFds[1] = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+  if ( notifyFds[0] < 0 )
+    return false;
+#else
+  if ( pipe( notifyFds ) ) {
+    notifyFds[0] = notifyFds[1] = -1;
+    return false;
+  }
+  for ( int i = 0; i < 2; i++ ) {
+    fcntl( notifyFds[i], F_SETFL, fcntl( notifyFds[i], F_GETFL ) | O_NONBLOCK );
+    fcntl( notifyFds[i], F_SETFD, FD_CLOEXEC );
+  }
+#endif
+
+  notifying.store( true, std::memory_order_seq_cst );
+
+  // Messages that have been queued before were not signalled. The
+  // fence pairs with the one in push( ): Either the producer sees
+  // notifying, or we see its message.
+  std::atomic_thread_fence( std::memory_order_seq_cst );
+  if ( back.load( std::memory_order_relaxed ) != front.load( std::memory_order_relaxed ) )
+    notify( );
+  return true;
+}
+
+// Signal the consumer. This is done by the producer.
+void MidiInApi :: MidiQueue :: notify( )
+{
+#if defined( _WIN32 ) && !defined( __CYGWIN__ )
+  SetEvent( ( HANDLE ) notifyEvent );
+#elif defined( __linux__ )
+  uint64_t value = 1;
+  ssize_t res = write( notifyFds[1], &value, sizeof( value ) );
+  ( void ) res;
+#else
+  // If the pipe is full, it is readable, anyway.
+  char value = 0;
+  ssize_t res = write( notifyFds[1], &value, sizeof( value ) );
+  ( void ) res;
+#endif
+}
+
+void MidiInApi :: MidiQueue :: resetNotification( )
+{
+#if defined( _WIN32 ) && !defined( __CYGWIN__ )
+  WaitForSingleObject( ( HANDLE ) notifyEvent, 0 );
+#elif defined( __linux__ )
+  uint64_t value;
+  ssize_t res = read( notifyFds[0], &value, sizeof( value ) );
+  ( void ) res;
+#else
+  char buffer[64];
+  while ( read( notifyFds[0], buffer, sizeof( buffer ) ) > 0 );
+#endif
+}
+
+// Wait until the queue is not empty or the timeout ( in ms ) expires.
+bool MidiInApi :: MidiQueue :: wait( int timeout )
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now( );
+  for ( ;; ) {
+    // pairs with the fence in push( )
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    if ( back.load( std::memory_order_relaxed ) != front.load( std::memory_order_relaxed ) )
       return true;
+
+    int remaining = -1;
+    if ( timeout >= 0 ) {
+      long long elapsed =
+        std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now( ) - start ).count( );
+      if ( elapsed >= timeout )
+        return false;
+      remaining = timeout - ( int ) elapsed;
     }
 
-  return false;
+#if defined( _WIN32 ) && !defined( __CYGWIN__ )
+    // This resets the event.
+    WaitForSingleObject( ( HANDLE ) notifyEvent,
+                         remaining < 0 ? INFINITE : ( DWORD ) remaining );
+#else
+    struct pollfd fd;
+    fd.fd = notifyFds[0];
+    fd.events = POLLIN;
+    fd.revents = 0;
+    if ( poll( &fd, 1, remaining ) > 0 )
+      resetNotification( );
+#endif
+  }
 }
 
-bool MidiInApi :: MidiQueue :: pop( std::vector<unsigned char>& msg, double& timeStamp )
+// Copy the contents of slot to data and release its memory.
+void MidiInApi :: MidiQueue :: copyMessage( QueuedMessage & slot,
+                                            unsigned char * data,
+                                            size_t & poolPosition )
 {
-  // Local stack copies of front/back
-  unsigned int _back, _front, _size;
+  if ( slot.overflow ) {
+    memcpy( data, slot.overflow, slot.size );
+    delete [] slot.overflow;
+    slot.overflow = 0;
+  } else if ( slot.size <= QueuedMessage::inlineSize ) {
+    memcpy( data, slot.bytes, slot.size );
+  } else {
+    size_t offset = poolPosition & ( poolSize - 1 );
+    size_t first = std::min( slot.size, poolSize - offset );
+    memcpy( data, pool + offset, first );
+    memcpy( data + first, pool, slot.size - first );
+    poolPosition += slot.size;
+  }
+}
 
-  // Get back/front indexes exactly once and calculate current size
-  _size = size( &_back, &_front );
+bool MidiInApi :: MidiQueue :: pop( std::vector<unsigned char>& msg, double& timeStamp,
+                                    int64_t * absoluteTime )
+{
+  // Only this thread writes front. The acquire on back pairs with the
+  // release in push( ) and makes the message contents visible.
+  unsigned int _front = front.load( std::memory_order_relaxed );
+  unsigned int _back = loadBack( _front );
 
-  if ( _size == 0 )
+  if ( _back == _front )
     return false;
 
   // Copy queued message to the vector pointer argument and then "pop" it.
-  msg.assign( ring[_front].bytes.begin( ), ring[_front].bytes.end( ) );
-  timeStamp = ring[_front].timeStamp;
+  QueuedMessage & slot = ring[_front & mask];
+  size_t _poolFront = poolFront.load( std::memory_order_relaxed );
+  timeStamp = slot.timeStamp;
+  if ( absoluteTime ) *absoluteTime = slot.absoluteTime;
+  msg.resize( slot.size );
+  if ( slot.size )
+    copyMessage( slot, msg.data( ), _poolFront );
 
   // Update front
-  front = ( front+1 )%ringSize;
+  poolFront.store( _poolFront, std::memory_order_release );
+  front.store( _front + 1, std::memory_order_release );
   return true;
 }
+
+// Return the size of the first message without removing it.
+size_t MidiInApi :: MidiQueue :: frontSize( )
+{
+  unsigned int _front = front.load( std::memory_order_relaxed );
+  unsigned int _back = loadBack( _front );
+  if ( _back == _front )
+    return 0;
+  return ring[_front & mask].size;
+}
+
+// Pop as many messages as possible. The indices are read and written
+// only once for all messages.
+size_t MidiInApi :: MidiQueue :: pop( unsigned char * data, size_t dataSize,
+                                      size_t * offsets, double * timeStamps,
+                                      size_t maxMessages,
+                                      int64_t * absoluteTimes )
+{
+  unsigned int _front = front.load( std::memory_order_relaxed );
+  unsigned int _back = loadBack( _front );
+  size_t _poolFront = poolFront.load( std::memory_order_relaxed );
+  size_t count = 0, position = 0;
+
+  offsets[0] = 0;
+  while ( count < maxMessages && _front != _back ) {
+    QueuedMessage & slot = ring[_front & mask];
+    if ( slot.size > dataSize - position )
+      break;
+    copyMessage( slot, data + position, _poolFront );
+    if ( timeStamps ) timeStamps[count] = slot.timeStamp;
+    if ( absoluteTimes ) absoluteTimes[count] = slot.absoluteTime;
+    position += slot.size;
+    offsets[++count] = position;
+    ++_front;
+  }
+
+  // Update front
+  poolFront.store( _poolFront, std::memory_order_release );
+  front.store( _front, std::memory_order_release );
+  return count;
+}
 #undef RTMIDI_CLASSNAME
 
 //*********************************************************************//
@@ -6690,13 +10266,49 @@ bool MidiInApi :: MidiQueue :: pop( std::vector<unsigned char>& msg, double& tim
 
 #define RTMIDI_CLASSNAME "MidiOutApi"
 MidiOutApi :: MidiOutApi( void )
-  : MidiApi( )
+  : MidiApi( ),
+    flushPolicy( MidiOut::FLUSH_IMMEDIATE ),
+    flushSize( 0 )
 {
 }
 
 MidiOutApi :: ~MidiOutApi( void )
 {
 }
+
+void MidiOutApi :: sendMessages( const unsigned char * data,
+                                 const size_t * offsets,
+                                 size_t count )
+{
+  for ( size_t i = 0; i < count; i++ )
+    sendMessage( data + offsets[i], offsets[i + 1] - offsets[i] );
+}
+
+size_t MidiOutApi :: trySendMessages( const unsigned char * data,
+                                     const size_t * offsets,
+                                     size_t count )
+{
+  sendMessages( data, offsets, count );
+  return count;
+}
+
+void MidiOutApi :: scheduleMessage( const unsigned char * message,
+                                    size_t size,
+                                    int64_t time )
+{
+  ( void ) time;
+  error( RTMIDI_ERROR( gettext_noopt( "This API does not support scheduled output. The message is sent immediately." ),
+                       Error::WARNING ) );
+  sendMessage( message, size );
+}
+
+void MidiOutApi :: setFlushPolicy( MidiOut::FlushPolicy policy, size_t size )
+{
+  flushPolicy = policy;
+  flushSize = size;
+  if ( policy == MidiOut::FLUSH_IMMEDIATE )
+    flush( );
+}
 #undef RTMIDI_CLASSNAME
 
 
@@ -61,6 +61,18 @@
 
 #define rtmidiUnused( x ) do { ( void ) x; } while ( 0 )
 
+// Size of a cache line. Data that is written by different threads is
+// kept at least this far apart to avoid false sharing.
+#ifndef RTMIDI_CACHE_LINE_SIZE
+#define RTMIDI_CACHE_LINE_SIZE 64
+#endif
+
+// Default size of the memory that each input queue reserves for
+// messages that are longer than a few bytes. Must be a power of two.
+#ifndef RTMIDI_SYSEX_POOL_SIZE
+#define RTMIDI_SYSEX_POOL_SIZE 65536
+#endif
+
 // Check for C++11 support
 #if defined ( _MSC_VER ) && _MSC_VER >= 1800
 // At least Visual Studio 2013
@@ -99,6 +111,7 @@
 #include <memory>
 #include <stdexcept>
 #include <atomic>
+#include <cstdint>
 // the following are used in the error constructor
 #include <cstdarg>
 #include <cstring>
@@ -128,6 +141,7 @@ enum ApiType {
               WINDOWS_MM, /*!< The Microsoft Multimedia MIDI API. */
               WINDOWS_KS, /*!< The Microsoft Kernel Streaming MIDI API. */
               DUMMY, /*!< A compilable but non-functional API. */
+              LINUX_ALSA_RAW, /*!< Direct access to ALSA raw MIDI devices. It must be selected explicitly, as the ALSA sequencer lists the same devices. */
               ALL_API, /*!< Use all available APIs for port selection. */
               NUM_APIS /*!< Number of values in this enum. */
 };
@@ -161,6 +175,50 @@ struct MidiInterface {
   virtual void delete_me ( ) {}
 };
 
+//! A MIDI message inside a buffer of the MIDI backend.
+/*!
+  The data belongs to the backend. It is valid only until the callback
+  function returns.
+
+  \sa MidiViewInterface
+*/
+struct MidiMessageView {
+  //! Pointer to the first byte of the message.
+  const unsigned char * data;
+  //! Number of bytes in the message.
+  size_t size;
+  //! Time in seconds elapsed since the previous message.
+  double timeStamp;
+  //! Time of arrival in nanoseconds in the clock domain of \ref Midi::getMonotonicTime.
+  int64_t absoluteTime;
+  //! The tag that has been passed to \ref MidiIn::setCallback.
+  /*! This allows to distinguish several inputs that share the same
+    callback object. It is 0 if no tag has been given or the message
+    did not come from a MIDI backend.
+  */
+  void * tag;
+};
+
+//! Zero-copy user callback interface.
+/*!
+  Objects of this class can be passed to \ref MidiIn::setCallback like
+  any other \ref MidiInterface. Each received MIDI message is passed to
+  \ref rtmidi_midi_in ( const MidiMessageView& ) as a view of the
+  buffer of the backend, so it is not copied into a std::vector
+  before. The vector based interface is provided as an adapter.
+*/
+struct MidiViewInterface : public MidiInterface {
+  //! The zero-copy MIDI callback function.
+  /*! This function is called whenever a MIDI message is received
+    by a MIDI backend that uses the corresponding callback object.
+    \param message a view of the message and its time stamp.
+  */
+  virtual void rtmidi_midi_in ( const MidiMessageView& message ) = 0;
+
+  //! Adapter for the vector based interface.
+  virtual void rtmidi_midi_in ( double timestamp, std::vector<unsigned char>& message );
+};
+
 /************************************************************************/
 /*! \class Error
   \brief Exception handling class for RtMidi.
@@ -340,6 +398,7 @@ using Pointer = std::shared_ptr<T>;
 class MidiApi;
 class MidiInApi;
 class MidiOutApi;
+class Route;
 typedef Pointer<MidiApi> MidiApiPtr;
 typedef std::list <MidiApiPtr> MidiApiList;
 
@@ -445,6 +504,20 @@ public:
   /*! \return true if both descriptors describe the same port
    */
   virtual bool operator == ( const PortDescriptor& o ) = 0;
+
+  //! Create a route from this port to another port.
+  /*! The default implementation returns 0, as the API cannot
+   * connect two foreign ports.
+   *
+   * \param destination The port that receives the messages.
+   * \param flags A combination of \ref Route::Flags.
+   * \return A new route or 0.
+   * \sa Midi::createRoute
+   */
+  virtual Route * createRoute ( const PortDescriptor& /* destination */,
+                                int /* flags */ ) const {
+    return 0;
+  }
 };
 
 //! A list of port descriptors.
@@ -454,6 +527,117 @@ public:
 typedef Pointer<PortDescriptor> PortPointer;
 typedef std::list<Pointer<PortDescriptor> > PortList;
 
+//! A port that has appeared, disappeared or changed.
+/*!
+  \sa PortChangeInterface
+*/
+struct PortChange {
+  //! The kind of the change.
+  enum Type {
+             ADDED, /*!< The port has been created. */
+             REMOVED, /*!< The port has been deleted. The
+                        descriptor can still be compared
+                        with other descriptors, but the port
+                        cannot be opened anymore. */
+             CHANGED /*!< The port or its client has been renamed or
+                       the capabilities of the port have changed. */
+  };
+  //! The kind of the change.
+  Type type;
+  //! A descriptor of the port.
+  PortPointer port;
+};
+
+//! Port change callback interface.
+/*!
+  Objects of this class can be passed to \ref Midi::setPortChangeCallback
+  to be notified when MIDI devices are plugged in or removed and when
+  other applications create or delete their ports.
+*/
+struct PortChangeInterface {
+  //! Virtual destructor to avoid unexpected behaviour.
+  virtual ~PortChangeInterface ( ) {}
+
+  //! The port change callback function.
+  /*! This function is called from a thread of the MIDI backend
+    after the port list has been updated. So, a call to \ref
+    Midi::getPortList from inside the callback returns the new list.
+    \param change the port and the kind of the change.
+  */
+  virtual void rtmidi_port_changed ( const PortChange& change ) = 0;
+
+  //! Delete the object if necessary.
+  /*! This function is called when the MIDI backend drops its
+    reference to the callback object. By default it does nothing.
+  */
+  virtual void delete_me ( ) {}
+};
+
+//! Buffer sizes of a MIDI backend.
+/*!
+  A value of 0 keeps the current size. For the ALSA sequencer the
+  buffers are the user space buffers of the client in bytes and the
+  pools are the numbers of events that the kernel holds for the
+  client.
+
+  \sa Midi::setBufferSizes
+*/
+struct BufferSizes {
+  size_t inputBuffer; //!< Size of the input buffer.
+  size_t outputBuffer; //!< Size of the output buffer.
+  size_t inputPool; //!< Number of incoming events the system may hold.
+  size_t outputPool; //!< Number of outgoing events the system may hold.
+
+  BufferSizes ( ) : inputBuffer ( 0 ),
+                    outputBuffer ( 0 ),
+                    inputPool ( 0 ),
+                    outputPool ( 0 ) {}
+};
+
+//! Message formats of a MIDI connection.
+/*!
+  A Universal MIDI Packet ( UMP ) consists of one to four 32 bit
+  words. Its size is given by the message type in the upper four bits
+  of the first word ( see \ref Midi::getUmpPacketSize ).
+
+  \sa Midi::setProtocol
+*/
+enum MidiProtocol {
+  MIDI_BYTE_STREAM, /*!< MIDI 1.0 byte stream ( default ). */
+  UMP_MIDI_1_0, /*!< Universal MIDI Packets with MIDI 1.0 channel voice messages. */
+  UMP_MIDI_2_0 /*!< Universal MIDI Packets with MIDI 2.0 channel voice messages. */
+};
+
+//! A connection between two ports that is handled by the MIDI system.
+/*!
+  The MIDI system passes the messages from the source to the
+  destination without involving the application. Compared with a
+  \ref MidiIn callback that forwards the messages to a \ref MidiOut
+  this saves two context switches per message.
+
+  Routes are created by \ref Midi::createRoute. The connection is
+  removed by \ref disconnect or when the last reference to the
+  route has been dropped. It is removed by the MIDI system, too, if
+  one of the ports disappears.
+*/
+class RTMIDI_DLL_PUBLIC Route {
+ public:
+  //! Options for \ref Midi::createRoute.
+  enum Flags {
+              TIMESTAMP = 1 /*!< Stamp the messages with the real time
+                              of a queue that is started with the
+                              route ( ALSA ) . */
+  };
+
+  //! The destructor removes the connection.
+  virtual ~Route ( ) {}
+
+  //! Remove the connection.
+  /*! Further calls have no effect. */
+  virtual void disconnect ( ) = 0;
+};
+typedef Pointer<Route> RoutePointer;
+
 /* A deprecated type. See below for the documentation. We
    split the definiton into several pieces to work around some
    intended warnings. */
@@ -508,6 +692,20 @@ class RTMIDI_DLL_PUBLIC Midi {
  //! A static function to determine the current RtMidi version.
  static std::string getVersion ( void ) throw ( );
 
+ //! Return the current time of the clock used for absolute time stamps.
+ /*!
+   All absolute time stamps of incoming messages are given in
+   nanoseconds of this clock. It is CLOCK_MONOTONIC on Linux and
+   other POSIX systems, the host time ( mach_absolute_time ) on
+   macOS and the performance counter on Windows. The clock is not
+   affected by changes of the system time, so it can be used to
+   compare messages of different ports or to correlate them with
+   other events of the same clock, e.g. audio buffers.
+
+   \return The current time in nanoseconds.
+ */
+ static int64_t getMonotonicTime ( ) throw ( );
+
  //! A static function to determine the available compiled MIDI APIs.
  /*!
    The values returned in the std::vector can be compared against
@@ -559,6 +757,33 @@ class RTMIDI_DLL_PUBLIC Midi {
  */
  static ApiType getCompiledApiByName ( const std::string& name, bool preferSystem = true );
 
+ //! Let objects with the same client name share one client of the MIDI system.
+ /*!
+   By default every MidiIn and MidiOut object registers its own
+   client with the MIDI system. If sharing is enabled, objects that
+   are created afterwards and use the same client name open their
+   ports on one common client. This saves resources of the MIDI
+   system and makes the opening of ports faster. Other
+   applications see one client with many ports.
+
+   The input of all ports of a shared client is handled by one
+   thread ( see \ref MidiIn::setSharedInputThreads ), which is
+   used even if no shared input threads have been requested.
+   Renaming a shared client renames it for all of its objects.
+
+   Currently only the ALSA backend supports shared clients.
+
+   \param shared \c true to share clients, \c false to create one
+   client per object.
+ */
+ static void setSharedClient ( bool shared );
+
+ //! Return whether new objects share their client.
+ /*! \sa setSharedClient */
+ static bool getSharedClient ( ) {
+   return sharedClient.load ( );
+ }
+
  //! Returns the MIDI API specifier for the current instance of rtmidi::MidiIn.
  ApiType getCurrentApi ( void ) throw ( );
 
@@ -610,12 +835,96 @@ class RTMIDI_DLL_PUBLIC Midi {
  */
  void setErrorCallback ( ErrorInterface * callback );
 
+ //! Set an object that is notified about changes of the available ports.
+ /*!
+   The callback is called whenever a port has been added or removed
+   or its name or capabilities have changed. Only ports that \ref
+   getPortList ( ) reports without \ref PortDescriptor::UNLIMITED are
+   taken into account. The callback is called from a thread of the
+   backend.
+
+   The backend keeps the port list up to date from the same
+   notifications, so \ref getPortList ( ) does not need to ask the
+   MIDI system anymore. On ALSA this continues after the callback has
+   been removed.
+
+   Currently only the ALSA backend supports port change notifications.
+
+   \param callback The object to be notified, or 0 to remove the
+   current one.
+ */
+ void setPortChangeCallback ( PortChangeInterface * callback );
+
+ //! Set the sizes of the buffers of the backend.
+ /*!
+   Larger buffers let bursts of messages like SysEx dumps pass
+   without overruns. The sizes should be set right after the object
+   has been created, before a port is opened. They apply to the
+   connection of this object to the MIDI system, which is used by all
+   objects of a shared client ( see \ref setSharedClient ).
+
+   Currently only the ALSA sequencer supports setting buffer sizes.
+
+   \param sizes The new sizes. Sizes of 0 are left unchanged.
+   \sa MidiIn::getOverrunCount
+ */
+ void setBufferSizes ( const BufferSizes& sizes );
+
+ //! Select the message format of the connection.
+ /*!
+   In the UMP modes each message is a single Universal MIDI Packet,
+   stored as 32 bit words in host byte order. So, messages have 4, 8,
+   12 or 16 bytes. This applies to received messages as well as to
+   the messages passed to \ref MidiOut::sendMessage and its
+   relatives ( see also \ref MidiOut::sendPackets ). The MIDI system
+   converts the messages of ports that use a different format.
+   MIDI 2.0 devices provide their full resolution only in \ref
+   UMP_MIDI_2_0 mode. \ref MidiIn::ignoreTypes applies to the
+   corresponding packet types.
+
+   The protocol must be selected before a port is opened. It applies
+   to the whole client, so it cannot be changed for a shared client
+   ( see \ref setSharedClient ).
+
+   Currently only the ALSA sequencer supports Universal MIDI
+   Packets. This requires ALSA 1.2.10 and Linux 6.5 or later.
+
+   \param protocol The new message format.
+ */
+ void setProtocol ( MidiProtocol protocol );
+
+ //! Return the size of a Universal MIDI Packet.
+ /*!
+   \param word The first word of the packet.
+   \return The number of 32 bit words in the packet ( 1 to 4 ).
+ */
+ static size_t getUmpPacketSize ( uint32_t word ) throw ( );
+
+ //! Connect two ports of other clients directly.
+ /*!
+   The messages of the source are passed to the destination by the
+   MIDI system ( see \ref Route ) . Both ports must belong to the
+   same API and allow other clients to connect to them.
+
+   Currently only the ALSA sequencer supports routes.
+
+   \param source The port that sends the messages.
+   \param destination The port that receives the messages.
+   \param flags A combination of \ref Route::Flags.
+   \return A handle of the connection.
+   \throw Error if the ports cannot be connected.
+ */
+ static RoutePointer createRoute ( const PortDescriptor& source,
+                                   const PortDescriptor& destination,
+                                   int flags = 0 );
+
  //! A basic error reporting function for RtMidi classes.
  void error ( Error e );
 
  static constexpr const auto UNSPECIFIED = rtmidi::UNSPECIFIED;
  static constexpr const auto MACOSX_CORE = rtmidi::MACOSX_CORE;
  static constexpr const auto LINUX_ALSA = rtmidi::LINUX_ALSA;
+ static constexpr const auto LINUX_ALSA_RAW = rtmidi::LINUX_ALSA_RAW;
  static constexpr const auto UNIX_JACK = rtmidi::UNIX_JACK;
  static constexpr const auto WINDOWS_MM = rtmidi::WINDOWS_MM;
  static constexpr const auto RTMIDI_DUMMY = rtmidi::DUMMY;
@@ -694,6 +1003,7 @@ class RTMIDI_DLL_PUBLIC Midi {
  MidiApiList * list;
  bool preferSystem;
  std::string clientName;
+ static std::atomic<bool> sharedClient;
 
  Midi ( MidiApiList * l,
         bool pfsystem,
@@ -851,11 +1161,14 @@ class RTMIDI_DLL_PUBLIC MidiIn : public Midi
     to set the callback function before opening a MIDI port to avoid
     leaving some messages in the queue.
 
+    If the callback object is derived from \ref MidiViewInterface,
+    the messages are passed without copying them into a std::vector.
+
     \param callback A callback function must be given.
-    \param userData Opitionally, a pointer to additional data can be
-    passed to the callback function whenever it is called.
+    \param tag A value that is passed to \ref MidiViewInterface
+    callbacks as \ref MidiMessageView::tag.
   */
-  void setCallback ( MidiInterface * callback );
+  void setCallback ( MidiInterface * callback, void * tag = 0 );
 
   //! Cancel use of the current callback function ( if one exists ) .
   /*!
@@ -876,6 +1189,58 @@ class RTMIDI_DLL_PUBLIC MidiIn : public Midi
                      bool midiTime = true,
                      bool midiSense = true );
 
+  //! Limit the size of incoming SysEx messages.
+  /*!
+    Backends that receive SysEx messages in chunks ( currently ALSA )
+    collect them in a buffer that grows as needed and is reused for
+    later messages. Messages that would exceed the limit are dropped
+    with a warning, which also limits the memory of the buffer.
+
+    \param size Maximum size of a SysEx message in bytes including
+    the leading 0xF0 and the trailing 0xF7. 0 ( the default ) means
+    no limit.
+  */
+  void setMaxSysexSize ( size_t size );
+
+  //! Return the number of input buffer overruns.
+  /*!
+    An overrun occurs when messages arrive faster than the backend
+    can take them. Some messages are lost then. Each overrun is also
+    reported as a warning. The buffers can be enlarged with \ref
+    setBufferSizes.
+
+    Currently only the ALSA sequencer and JACK detect overruns.
+
+    \return The number of overruns since the object has been created.
+  */
+  size_t getOverrunCount ( );
+
+  //! Call the callback in the realtime thread of the backend.
+  /*!
+    JACK receives messages in its process callback, which must not
+    block. By default the messages are copied into a preallocated
+    buffer, and a separate thread passes them to the callback or the
+    input queue. With \c enable set to \c true, the callback is called
+    directly from the process callback instead. This saves a thread
+    switch per period. But the callback must be realtime safe then:
+    it must not allocate memory, take locks that other threads hold
+    for a long time, do input or output or call functions of RtMidi
+    other than those that only read data. Otherwise the whole audio
+    graph may miss its deadline.
+
+    Only callbacks that implement \ref MidiViewInterface are called
+    from the realtime thread, as the message is passed to them without
+    copying it. Vector based callbacks and the input queue need memory
+    allocation and error reporting, so their messages always go
+    through the separate thread.
+
+    Other backends already call the callback from their own non
+    realtime thread. They ignore this setting.
+
+    \param enable \c true to call the callback in the realtime thread.
+  */
+  void setRealtimeCallback ( bool enable );
+
   //! Fill the user-provided vector with the data bytes for the next available MIDI message in the input queue and return the event delta-time in seconds.
   /*!
     This function returns immediately whether a new message is
@@ -886,6 +1251,120 @@ class RTMIDI_DLL_PUBLIC MidiIn : public Midi
   */
   double getMessage ( std::vector<unsigned char>& message );
 
+  //! Retrieve the next message from the input queue together with its absolute time stamp.
+  /*!
+    This function behaves like \ref getMessage ( std::vector<unsigned char>& ).
+    Additionally it stores the time of arrival of the message in
+    nanoseconds in \c absoluteTime. The time is given in the clock
+    domain of \ref Midi::getMonotonicTime. It is left unchanged if
+    no message is available.
+
+    \return The delta-time in seconds since the previous message.
+  */
+  double getMessage ( std::vector<unsigned char>& message, int64_t& absoluteTime );
+
+  //! Move several messages from the input queue into a user-provided buffer.
+  /*!
+    The messages are stored back to back in \c data. Message \c i
+    consists of the bytes from \c data[offsets[i]] up to, but not
+    including, \c data[offsets[i+1]]. Its delta-time in seconds is
+    stored in \c timeStamps[i] and its absolute time stamp in
+    \c absoluteTimes[i].
+
+    This function returns immediately whether messages are available
+    or not. A message that does not fit into the remaining space of
+    \c data is left in the queue for the next call. If it does not
+    fit into \c data at all, no message is returned until a larger
+    buffer is passed. \ref getNextMessageSize tells how large it
+    must be.
+
+    \param data Buffer that receives the bytes of the messages.
+    \param dataSize Size of \c data in bytes.
+    \param offsets Array of at least \c maxMessages + 1 elements
+    that receives the positions of the messages in \c data.
+    \param timeStamps Array of at least \c maxMessages elements
+    that receives the delta-times of the messages. May be 0.
+    \param maxMessages Maximum number of messages to be read.
+    \param absoluteTimes Array of at least \c maxMessages elements
+    that receives the times of arrival in nanoseconds in the clock
+    domain of \ref Midi::getMonotonicTime. May be 0.
+
+    \return The number of messages that have been read.
+  */
+  size_t getMessages ( unsigned char * data, size_t dataSize,
+                       size_t * offsets, double * timeStamps,
+                       size_t maxMessages,
+                       int64_t * absoluteTimes = 0 );
+
+  //! Return the size of the next message in the input queue.
+  /*!
+    This allows to provide a buffer that is large enough for \ref
+    getMessages, e.g. for SysEx messages of unknown size.
+
+    \return The number of bytes of the first queued message or 0 if
+    the queue is empty.
+  */
+  size_t getNextMessageSize ( );
+
+  //! Wait until a message is available in the input queue.
+  /*!
+    This function blocks the calling thread until the backend has
+    queued a message or the timeout has expired. It does not consume
+    CPU time while waiting. Afterwards the message can be retrieved
+    with \ref getMessage or \ref getMessages.
+
+    \param timeout Maximum time to wait in milliseconds. A negative
+    value waits without a time limit.
+
+    \return \c true if a message is available, \c false if the
+    timeout has expired.
+  */
+  bool waitForMessage ( int timeout = -1 );
+
+  //! Return a file descriptor that becomes readable when messages arrive.
+  /*!
+    The descriptor can be used with poll ( ) , select ( ) or an event
+    loop to wait for input together with other events. When it
+    becomes readable, retrieve messages with \ref getMessage or \ref
+    getMessages until the queue is empty. The descriptor is reset
+    when these functions find the queue empty. The descriptor
+    belongs to the MIDI input and must not be closed or read by the
+    caller.
+
+    \return A file descriptor or -1 if the platform does not provide
+    a pollable descriptor ( Windows ) or it could not be created.
+  */
+  int getPollDescriptor ( );
+
+  //! Let several inputs share a small number of input threads.
+  /*!
+    By default every open input port has its own thread that waits
+    for incoming messages. With a non-zero value inputs that are
+    opened afterwards are served by a shared pool of at most \c
+    threads threads. Each of them waits for the messages of many
+    ports at once and dispatches them to the respective callbacks
+    and queues. This reduces the number of threads and wakeups if
+    many ports are open. Ports that are already open are not
+    affected.
+
+    Callbacks of ports that share a thread are called one after
+    another. A long running callback delays the other ports. A
+    callback may close its own port, but it must not close ports
+    that are served by a different thread.
+
+    Currently only the ALSA backend uses shared input threads.
+
+    \param threads Maximum number of shared threads, or 0 for one
+    thread per port.
+  */
+  static void setSharedInputThreads ( unsigned int threads );
+
+  //! Return the number of shared input threads.
+  /*! \sa setSharedInputThreads */
+  static unsigned int getSharedInputThreads ( ) {
+    return sharedInputThreads.load ( );
+  }
+
 
   //! Set a callback function to be invoked for incoming MIDI messages.
   /*!
@@ -915,6 +1394,7 @@ class RTMIDI_DLL_PUBLIC MidiIn : public Midi
                       "Please, use a C++ style reference to pass the message vector." );
  protected:
   static MidiApiList queryApis;
+  static std::atomic<unsigned int> sharedInputThreads;
   int queueSizeLimit;
   void openMidiApi ( ApiType api );
 
@@ -942,6 +1422,23 @@ class RTMIDI_DLL_PUBLIC MidiOut : public Midi
 {
  public:
 
+  //! Policies that decide when buffered output is passed to the system.
+  /*!
+    Only backends that buffer their output ( currently ALSA ) use
+    these policies. All other backends send each message immediately.
+
+    \sa setFlushPolicy
+  */
+  enum FlushPolicy {
+    FLUSH_IMMEDIATE, /*!< Each call of \ref sendMessage or \ref
+                       sendMessages is flushed before it returns
+                       ( default ). */
+    FLUSH_ON_SIZE,   /*!< Messages are collected until a given number
+                       of bytes has been sent or \ref flush is called. */
+    FLUSH_EXPLICIT   /*!< Messages are collected until \ref flush is
+                       called or the buffer of the backend is full. */
+  };
+
   //! Default constructor that allows an optional client name.
   /*!
     An exception will be thrown if a MIDI system initialization error occurs.
@@ -1062,6 +1559,133 @@ class RTMIDI_DLL_PUBLIC MidiOut : public Midi
   */
   void sendMessage ( const unsigned char * message, size_t size );
 
+  //! Send several messages out an open MIDI output port at once.
+  /*!
+    The messages are stored back to back in \c data. Message \c i
+    consists of the bytes from \c data[offsets[i]] up to, but not
+    including, \c data[offsets[i+1]]. This is the same layout as
+    returned by \ref MidiIn::getMessages.
+
+    Buffering backends pass the whole batch to the system at once
+    instead of once per message. With \ref FLUSH_IMMEDIATE, the
+    messages are flushed before the function returns.
+
+    An exception is thrown if an error occurs during output or an
+    output connection was not previously established.
+
+    \param data The bytes of the messages.
+    \param offsets Array of \c count + 1 positions in \c data.
+    \param count Number of messages.
+  */
+  void sendMessages ( const unsigned char * data,
+                      const size_t * offsets,
+                      size_t count );
+
+  //! Send Universal MIDI Packets.
+  /*!
+    This is a convenience function for outputs that use one of the
+    UMP modes ( see \ref Midi::setProtocol ). The words are passed to
+    \ref sendMessage. They may contain several packets.
+
+    \param words The packets in host byte order.
+    \param count Number of words.
+  */
+  void sendPackets ( const uint32_t * words, size_t count ) {
+    sendMessage ( reinterpret_cast<const unsigned char *> ( words ),
+                  count * sizeof ( uint32_t ) );
+  }
+
+  //! Send as many messages as the system accepts without waiting.
+  /*!
+    The messages are stored like for \ref sendMessages. They are
+    taken from the beginning as long as the backend has room for
+    them. The remaining messages are left to the caller, who can
+    send them after \ref getPollDescriptor has become writable.
+    This lets a producer throttle itself instead of losing messages
+    or being blocked.
+
+    The accepted messages are passed to the system regardless of the
+    flush policy. Messages the system cannot take at once stay in the
+    output buffer and go first with the next call of this function or
+    \ref flush.
+
+    A message that does not fit into the output buffer at all is
+    never accepted. It ends the batch. When it is the first message,
+    an error of type Error::INVALID_PARAMETER is raised instead. If
+    an error callback is installed, the message is dropped and
+    counted as accepted. The buffer can be enlarged with \ref
+    setBufferSizes.
+
+    Backends that cannot report a full buffer accept all messages
+    like \ref sendMessages. Currently only the ALSA sequencer and
+    ALSA raw MIDI report it. The buffer of a raw MIDI device has the
+    size chosen by its driver.
+
+    \param data The bytes of the messages.
+    \param offsets Array of \c count + 1 positions in \c data.
+    \param count Number of messages.
+    \return The number of messages that have been accepted.
+  */
+  size_t trySendMessages ( const unsigned char * data,
+                           const size_t * offsets,
+                           size_t count );
+
+  //! Return a file descriptor that becomes writable when there is room for output.
+  /*!
+    The descriptor can be used with poll ( ) , select ( ) or an event
+    loop to wait until \ref trySendMessages accepts messages again.
+    Wait only for writability ( POLLOUT ). The descriptor may be
+    shared with the input of the backend and must not be read,
+    written or closed by the caller.
+
+    \return A file descriptor or -1 if the backend does not provide
+    one.
+  */
+  int getPollDescriptor ( );
+
+  //! Pass all buffered messages to the system.
+  /*!
+    This is necessary only if a flush policy other than \ref
+    FLUSH_IMMEDIATE has been selected.
+
+    \sa setFlushPolicy
+  */
+  void flush ( );
+
+  //! Select when buffered messages are passed to the system.
+  /*!
+    \param policy The new policy. Switching to \ref FLUSH_IMMEDIATE
+    flushes the buffered messages.
+    \param size Number of MIDI bytes after which the messages are
+    flushed with \ref FLUSH_ON_SIZE. It is ignored by the other
+    policies.
+  */
+  void setFlushPolicy ( FlushPolicy policy, size_t size = 0 );
+
+  //! Send a single message at a given time.
+  /*!
+    The message is passed to the backend at once, which delivers it
+    at the requested time. So, the timing does not depend on when
+    the calling thread is scheduled. Messages for times in the past
+    are delivered immediately.
+
+    Backends that cannot schedule output send the message
+    immediately and report a warning. ALSA schedules the message on
+    a real time queue of the sequencer. There, the number of pending
+    messages is limited by the output pool of the client. Buffered
+    messages are subject to the flush policy like any other message.
+    JACK places the message at its frame in the period in which it
+    is due. It holds a limited number of pending messages. While
+    that is exhausted, later messages wait in the output buffer.
+
+    \param message A pointer to the MIDI message as raw bytes
+    \param size Length of the MIDI message in bytes
+    \param time Time of delivery in nanoseconds in the clock domain
+    of \ref Midi::getMonotonicTime.
+  */
+  void scheduleMessage ( const unsigned char * message, size_t size,
+                         int64_t time );
+
  protected:
   static MidiApiList queryApis;
   void openMidiApi ( ApiType api );
@@ -1220,6 +1844,37 @@ class RTMIDI_DLL_PUBLIC MidiApi
   */
   virtual void setErrorCallback ( ErrorInterface * callback );
 
+  //! Virtual function to set the port change callback object
+  /*!
+    The default implementation issues a warning, as the API does not
+    support port change notifications.
+
+    \param callback The object to be notified, or 0 to remove the current one.
+    \sa Midi::setPortChangeCallback
+  */
+  virtual void setPortChangeCallback ( PortChangeInterface * callback );
+
+  //! Virtual function to set the buffer sizes of the backend
+  /*!
+    The default implementation issues a warning, as the API does not
+    support setting buffer sizes.
+
+    \param sizes The new sizes.
+    \sa Midi::setBufferSizes
+  */
+  virtual void setBufferSizes ( const BufferSizes& sizes );
+
+  //! Virtual function to select the message format
+  /*!
+    The default implementation issues a warning unless the MIDI 1.0
+    byte stream is selected, as the API does not support Universal
+    MIDI Packets.
+
+    \param protocol The new message format.
+    \sa Midi::setProtocol
+  */
+  virtual void setProtocol ( MidiProtocol protocol );
+
 
   //! Returns the MIDI API specifier for the current instance of RtMidiIn.
   virtual ApiType getCurrentApi ( void ) throw ( ) = 0;
@@ -1266,10 +1921,21 @@ class RTMIDI_DLL_PUBLIC MidiInApi : public MidiApi
 
   MidiInApi ( unsigned int queueSizeLimit );
   virtual ~MidiInApi ( void );
-  void setCallback ( MidiInterface * callback );
+  void setCallback ( MidiInterface * callback, void * tag = 0 );
   void cancelCallback ( void );
   virtual void ignoreTypes ( bool midiSysex, bool midiTime, bool midiSense );
+  void setMaxSysexSize ( size_t size ) { maxSysexSize = size; }
+  size_t getOverrunCount ( ) const { return overruns.load ( ); }
+  void setRealtimeCallback ( bool enable ) { realtimeCallback = enable; }
   double getMessage ( std::vector<unsigned char>& message );
+  double getMessage ( std::vector<unsigned char>& message, int64_t& absoluteTime );
+  size_t getMessages ( unsigned char * data, size_t dataSize,
+                       size_t * offsets, double * timeStamps,
+                       size_t maxMessages,
+                       int64_t * absoluteTimes = 0 );
+  size_t getNextMessageSize ( );
+  bool waitForMessage ( int timeout = -1 );
+  int getPollDescriptor ( );
 
   // A MIDI structure used internally by the class to store incoming
   // messages. Each message represents one and only one MIDI message.
@@ -1277,23 +1943,96 @@ class RTMIDI_DLL_PUBLIC MidiInApi : public MidiApi
     std::vector<unsigned char> bytes;
     //! Time in seconds elapsed since the previous message
     double timeStamp;
+    //! Time of arrival in nanoseconds ( see Midi::getMonotonicTime )
+    int64_t absoluteTime;
 
     // Default constructor.
     MidiMessage ( )
-      : bytes ( 0 ), timeStamp ( 0.0 ) {}
+      : bytes ( 0 ), timeStamp ( 0.0 ), absoluteTime ( 0 ) {}
+  };
+
+  // An entry of the input queue. Short messages are stored inline.
+  // Longer messages (i.e. SysEx) are stored in the pool of the queue,
+  // or in a separately allocated buffer if they don't fit into it.
+  struct QueuedMessage {
+    enum { inlineSize = 8 };
+    //! Time in seconds elapsed since the previous message
+    double timeStamp;
+    //! Time of arrival in nanoseconds ( see Midi::getMonotonicTime )
+    int64_t absoluteTime;
+    size_t size;
+    unsigned char * overflow;
+    unsigned char bytes[inlineSize];
+
+    // Default constructor.
+    QueuedMessage ( )
+      : timeStamp ( 0.0 ), absoluteTime ( 0 ), size ( 0 ), overflow ( 0 ) {}
   };
 
+  // A single producer/single consumer ring buffer. back is written
+  // only by the backend (push), front only by the user (pop). Both
+  // indices run freely and are reduced modulo ringSize, which is a
+  // power of two, so the difference is always the number of queued
+  // messages. The same holds for the indices into the SysEx
+  // pool. Messages are copied into preallocated memory, so the
+  // backend thread doesn't allocate memory in the common case. The
+  // padding keeps the data of both threads and the shared read-only
+  // fields on different cache lines.
   struct MidiQueue {
-    unsigned int front;
-    unsigned int back;
+    std::atomic<unsigned int> front;
+    std::atomic<size_t> poolFront;
+    char frontPadding[RTMIDI_CACHE_LINE_SIZE
+                      - sizeof ( std::atomic<unsigned int> )
+                      - sizeof ( std::atomic<size_t> )];
+    std::atomic<unsigned int> back;
+    size_t poolBack;
+    char backPadding[RTMIDI_CACHE_LINE_SIZE
+                     - sizeof ( std::atomic<unsigned int> )
+                     - sizeof ( size_t )];
+    unsigned int limit;
     unsigned int ringSize;
-    MidiMessage * ring;
+    unsigned int mask;
+    QueuedMessage * ring;
+    size_t poolSize;
+    unsigned char * pool;
+    // Wakeup of a waiting consumer. The descriptors are created on
+    // demand by the consumer. notifyFds[0] is the end that can be
+    // polled, notifyFds[1] the end that is signalled. notifyEvent
+    // is used instead on Windows.
+    std::atomic<bool> notifying;
+    int notifyFds[2];
+    void * notifyEvent;
 
     // Default constructor.
     MidiQueue ( )
-      : front ( 0 ), back ( 0 ), ringSize ( 0 ), ring ( 0 ) {}
-    bool push ( const MidiMessage& );
-    bool pop ( std::vector<unsigned char>& message, double& timestamp );
+      : front ( 0 ), poolFront ( 0 ), back ( 0 ), poolBack ( 0 ),
+        limit ( 0 ), ringSize ( 0 ), mask ( 0 ), ring ( 0 ),
+        poolSize ( 0 ), pool ( 0 ), notifying ( false ),
+        notifyEvent ( 0 ) {
+      notifyFds[0] = notifyFds[1] = -1;
+    }
+    ~MidiQueue ( );
+    void allocate ( unsigned int queueSizeLimit,
+                    size_t sysexPoolSize = RTMIDI_SYSEX_POOL_SIZE );
+    bool push ( const unsigned char * data, size_t size,
+                double timeStamp, int64_t absoluteTime );
+    bool push ( const MidiMessage& message ) {
+      return push ( message.bytes.data ( ), message.bytes.size ( ),
+                    message.timeStamp, message.absoluteTime );
+    }
+    bool pop ( std::vector<unsigned char>& message, double& timestamp,
+               int64_t * absoluteTime = 0 );
+    size_t pop ( unsigned char * data, size_t dataSize,
+                 size_t * offsets, double * timeStamps,
+                 size_t maxMessages, int64_t * absoluteTimes = 0 );
+    size_t frontSize ( );
+    void copyMessage ( QueuedMessage & slot, unsigned char * data,
+                       size_t & poolPosition );
+    unsigned int loadBack ( unsigned int front );
+    bool enableNotification ( );
+    void notify ( );
+    void resetNotification ( );
+    bool wait ( int timeout );
     unsigned int size ( unsigned int * back=0,
                         unsigned int * front=0 );
   };
@@ -1314,14 +2053,37 @@ class RTMIDI_DLL_PUBLIC MidiInApi : public MidiApi
     }
 
  protected:
+  // Pass a complete message to the callback object or the queue.
+  // These functions are called from the thread of the backend and
+  // don't throw exceptions. The data must stay valid until the
+  // function returns. absoluteTime is the time of arrival in the
+  // clock domain of Midi::getMonotonicTime.
+  void deliverMessage ( const unsigned char * data, size_t size,
+                        double timeStamp, int64_t absoluteTime );
+  void deliverMessage ( std::vector<unsigned char>& data,
+                        double timeStamp, int64_t absoluteTime );
+
   // The RtMidiInData structure is used to pass private class data to
   // the MIDI input handling function or thread.
   MidiQueue queue;
   MidiMessage message;
   unsigned char ignoreFlags;
+  // Maximum size of a SysEx message or 0. It may be changed while
+  // the input thread reads it.
+  std::atomic<size_t> maxSysexSize;
+  // Number of input buffer overruns.
+  std::atomic<size_t> overruns;
+  // Deliver messages in the realtime thread ( see MidiIn::setRealtimeCallback ).
+  std::atomic_bool realtimeCallback;
   std::atomic_bool doInput;
   bool firstMessage;
   MidiInterface * userCallback;
+  // userCallback, if it supports the zero-copy interface.
+  MidiViewInterface * viewCallback;
+  // Passed to viewCallback as MidiMessageView::tag.
+  void * callbackTag;
+  // Used to pass raw data to vector based callbacks.
+  std::vector<unsigned char> callbackBuffer;
   bool continueSysex;
   friend struct JackBackendCallbacks;
 };
@@ -1335,6 +2097,22 @@ class RTMIDI_DLL_PUBLIC MidiOutApi : public MidiApi
   MidiOutApi ( void );
   virtual ~MidiOutApi ( void );
   virtual void sendMessage ( const unsigned char * message, size_t size ) = 0;
+  //! Send the messages one by one, unless the backend can do better.
+  virtual void sendMessages ( const unsigned char * data,
+                              const size_t * offsets,
+                              size_t count );
+  //! Accept all messages, unless the backend can report a full buffer.
+  virtual size_t trySendMessages ( const unsigned char * data,
+                                   const size_t * offsets,
+                                   size_t count );
+  //! Backends that cannot report a full buffer have no descriptor.
+  virtual int getPollDescriptor ( ) { return -1; }
+  //! Backends without an output buffer have nothing to flush.
+  virtual void flush ( ) {}
+  //! Send the message immediately, unless the backend can schedule it.
+  virtual void scheduleMessage ( const unsigned char * message, size_t size,
+                                 int64_t time );
+  void setFlushPolicy ( MidiOut::FlushPolicy policy, size_t size );
   void sendMessage ( const std::vector<unsigned char>& message )
   {
     if ( message.empty ( ) ) {
@@ -1353,9 +2131,145 @@ class RTMIDI_DLL_PUBLIC MidiOutApi : public MidiApi
       }
       sendMessage ( * message );
     }
+
+ protected:
+  MidiOut::FlushPolicy flushPolicy;
+  size_t flushSize;
 };
 #undef RTMIDI_CLASSNAME
 
+/*! Splits a stream of MIDI bytes into messages.
+
+  Running status is resolved. Real time messages are passed on
+  immediately, even if they interrupt another message. SysEx messages
+  are collected in a buffer that keeps its capacity for the next
+  message. Data bytes without a status byte are dropped.
+
+  Backends that receive the bytes of a MIDI stream, like the ALSA raw
+  MIDI interface, use it to find the message boundaries.
+*/
+class MidiStreamParser {
+public:
+  MidiStreamParser ( )
+    : runningStatus ( 0 ),
+      expected ( 0 ),
+      sysex ( false ),
+      discard ( false ) {}
+
+  void reset ( ) {
+    message.clear ( );
+    runningStatus = 0;
+    expected = 0;
+    sysex = false;
+    discard = false;
+  }
+
+  /*! Call deliver ( data, size ) for each message that is completed
+    by the given bytes.
+
+    \param maxSysexSize SysEx messages that are longer are dropped
+    ( 0 means unlimited ).
+    \param skipSysex SysEx messages are not collected at all.
+    \return true if a SysEx message has been dropped.
+  */
+  template <class Deliver>
+  bool parse ( const unsigned char * data, size_t size,
+              size_t maxSysexSize, bool skipSysex,
+              Deliver deliver );
+
+protected:
+  static size_t messageSize ( unsigned char status ) {
+    if ( status < 0xF0 )
+      return ( status & 0xE0 ) == 0xC0 ? 2 : 3;
+    switch ( status ) {
+    case 0xF1: // MIDI time code quarter frame
+    case 0xF3: // song select
+      return 2;
+    case 0xF2: // song position pointer
+      return 3;
+    default:
+      return 1;
+    }
+  }
+
+  std::vector<unsigned char> message;
+  unsigned char runningStatus;
+  size_t expected; // size of the current message
+  bool sysex; // inside of F0 ... F7
+  bool discard; // the current SysEx message is dropped
+};
+
+template <class Deliver>
+inline bool MidiStreamParser :: parse ( const unsigned char * data, size_t size,
+                                        size_t maxSysexSize, bool skipSysex,
+                                        Deliver deliver )
+{
+  bool dropped = false;
+  for ( size_t i = 0; i < size; i++ ) {
+    unsigned char byte = data[i];
+    if ( byte >= 0xF8 ) {
+      deliver ( data + i, 1 );
+      continue;
+    }
+
+    if ( byte & 0x80 ) {
+      if ( sysex ) {
+        // Any status byte ends a SysEx message, but only F7
+        // completes it.
+        sysex = false;
+        if ( byte == 0xF7 ) {
+          if ( !discard ) {
+            message.push_back ( byte );
+            deliver ( message.data ( ), message.size ( ) );
+          }
+          message.clear ( );
+          continue;
+        }
+      }
+      message.clear ( );
+      switch ( byte ) {
+      case 0xF0:
+        sysex = true;
+        discard = skipSysex;
+        runningStatus = 0;
+        if ( !discard )
+          message.push_back ( byte );
+        continue;
+      case 0xF7: // stray end of SysEx
+        continue;
+      }
+      // System common messages cancel the running status.
+      runningStatus = byte < 0xF0 ? byte : 0;
+      expected = messageSize ( byte );
+      message.push_back ( byte );
+    } else if ( sysex ) {
+      if ( discard ) continue;
+      // Leave room for the final F7.
+      if ( maxSysexSize && message.size ( ) + 1 >= maxSysexSize ) {
+        discard = true;
+        dropped = true;
+        message.clear ( );
+        continue;
+      }
+      message.push_back ( byte );
+      continue;
+    } else {
+      if ( message.empty ( ) ) {
+        if ( !runningStatus ) continue;
+        message.push_back ( runningStatus );
+        expected = messageSize ( runningStatus );
+      }
+      message.push_back ( byte );
+    }
+
+    if ( message.size ( ) == expected ) {
+      deliver ( message.data ( ), message.size ( ) );
+      message.clear ( );
+    }
+  }
+  return dropped;
+}
+
 
 // **************************************************************** //
 //
@@ -1409,6 +2323,15 @@ inline bool Midi :: isPortOpen ( void ) const {
 inline void Midi :: setErrorCallback ( ErrorInterface * callback ) {
   if ( rtapi_ ) rtapi_->setErrorCallback ( callback );
 }
+inline void Midi :: setPortChangeCallback ( PortChangeInterface * callback ) {
+  if ( rtapi_ ) rtapi_->setPortChangeCallback ( callback );
+}
+inline void Midi :: setBufferSizes ( const BufferSizes& sizes ) {
+  if ( rtapi_ ) rtapi_->setBufferSizes ( sizes );
+}
+inline void Midi :: setProtocol ( MidiProtocol protocol ) {
+  if ( rtapi_ ) rtapi_->setProtocol ( protocol );
+}
 #if 0
 inline void Midi :: getCompiledApi ( std::vector<Api>& apis, bool
                                      preferSystem ) throw ( ) {
@@ -1457,6 +2380,13 @@ inline Midi :: ~Midi ( ) {
 }
 #undef RTMIDI_CLASSNAME
 
+inline void MidiViewInterface :: rtmidi_midi_in ( double timestamp,
+                                                  std::vector<unsigned char>& message ) {
+  MidiMessageView view = { message.data ( ), message.size ( ), timestamp,
+                           Midi::getMonotonicTime ( ), 0 };
+  rtmidi_midi_in ( view );
+}
+
 #define RTMIDI_CLASSNAME "MidiIn"
 // rtmidi::MidiIn
 inline bool MidiIn :: hasVirtualPorts ( ) {
@@ -1512,9 +2442,9 @@ inline void MidiIn :: openVirtualPort ( const std::string& portName ) {
                            Error::INVALID_DEVICE ) );
   }
 }
-inline void MidiIn :: setCallback ( MidiInterface * callback ) {
+inline void MidiIn :: setCallback ( MidiInterface * callback, void * tag ) {
   if ( rtapi_ )
-    static_cast<MidiInApi *> ( rtapi_ ) ->setCallback ( callback );
+    static_cast<MidiInApi *> ( rtapi_ ) ->setCallback ( callback, tag );
 }
 inline void MidiIn :: cancelCallback ( ) {
   if ( rtapi_ )
@@ -1526,6 +2456,19 @@ inline void MidiIn :: ignoreTypes ( bool midiSysex,
   if ( rtapi_ )
     static_cast<MidiInApi *> ( rtapi_ ) ->ignoreTypes ( midiSysex, midiTime, midiSense );
 }
+inline void MidiIn :: setMaxSysexSize ( size_t size ) {
+  if ( rtapi_ )
+    static_cast<MidiInApi *> ( rtapi_ ) ->setMaxSysexSize ( size );
+}
+inline size_t MidiIn :: getOverrunCount ( ) {
+  if ( rtapi_ )
+    return static_cast<MidiInApi *> ( rtapi_ ) ->getOverrunCount ( );
+  return 0;
+}
+inline void MidiIn :: setRealtimeCallback ( bool enable ) {
+  if ( rtapi_ )
+    static_cast<MidiInApi *> ( rtapi_ ) ->setRealtimeCallback ( enable );
+}
 inline double MidiIn :: getMessage ( std::vector<unsigned char>& message ) {
   if ( rtapi_ )
     return static_cast<MidiInApi *> ( rtapi_ ) ->getMessage ( message );
@@ -1533,6 +2476,48 @@ inline double MidiIn :: getMessage ( std::vector<unsigned char>& message ) {
                          Error::WARNING ) );
   return 0.0;
 }
+inline double MidiIn :: getMessage ( std::vector<unsigned char>& message,
+                                    int64_t& absoluteTime ) {
+  if ( rtapi_ )
+    return static_cast<MidiInApi *> ( rtapi_ ) ->getMessage ( message, absoluteTime );
+  error ( RTMIDI_ERROR ( gettext_noopt ( "Could not find any valid MIDI system." ),
+                         Error::WARNING ) );
+  return 0.0;
+}
+inline size_t MidiIn :: getMessages ( unsigned char * data, size_t dataSize,
+                                     size_t * offsets, double * timeStamps,
+                                     size_t maxMessages,
+                                     int64_t * absoluteTimes ) {
+  if ( rtapi_ )
+    return static_cast<MidiInApi *> ( rtapi_ ) ->getMessages ( data, dataSize,
+                                                              offsets, timeStamps,
+                                                              maxMessages,
+                                                              absoluteTimes );
+  error ( RTMIDI_ERROR ( gettext_noopt ( "Could not find any valid MIDI system." ),
+                         Error::WARNING ) );
+  return 0;
+}
+inline size_t MidiIn :: getNextMessageSize ( ) {
+  if ( rtapi_ )
+    return static_cast<MidiInApi *> ( rtapi_ ) ->getNextMessageSize ( );
+  error ( RTMIDI_ERROR ( gettext_noopt ( "Could not find any valid MIDI system." ),
+                         Error::WARNING ) );
+  return 0;
+}
+inline bool MidiIn :: waitForMessage ( int timeout ) {
+  if ( rtapi_ )
+    return static_cast<MidiInApi *> ( rtapi_ ) ->waitForMessage ( timeout );
+  error ( RTMIDI_ERROR ( gettext_noopt ( "Could not find any valid MIDI system." ),
+                         Error::WARNING ) );
+  return false;
+}
+inline int MidiIn :: getPollDescriptor ( ) {
+  if ( rtapi_ )
+    return static_cast<MidiInApi *> ( rtapi_ ) ->getPollDescriptor ( );
+  error ( RTMIDI_ERROR ( gettext_noopt ( "Could not find any valid MIDI system." ),
+                         Error::WARNING ) );
+  return -1;
+}
 inline void MidiIn :: setCallback ( MidiCallback callback, void * userData ) {
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -1625,6 +2610,61 @@ inline void MidiOut :: sendMessage ( const unsigned char * message, size_t size
     error ( RTMIDI_ERROR ( gettext_noopt ( "No valid MIDI system has been selected." ),
                            Error::WARNING ) );
 }
+inline void MidiOut :: sendMessages ( const unsigned char * data,
+                                      const size_t * offsets,
+                                      size_t count ) {
+  if ( count && ( !data || !offsets ) ) {
+    error ( RTMIDI_ERROR ( gettext_noopt ( "No data in MIDI message." ),
+                           Error::INVALID_PARAMETER ) );
+    return;
+  }
+  if ( rtapi_ )
+    static_cast<MidiOutApi *> ( rtapi_ ) ->sendMessages ( data, offsets, count );
+  else
+    error ( RTMIDI_ERROR ( gettext_noopt ( "No valid MIDI system has been selected." ),
+                           Error::WARNING ) );
+}
+inline size_t MidiOut :: trySendMessages ( const unsigned char * data,
+                                           const size_t * offsets,
+                                           size_t count ) {
+  if ( count && ( !data || !offsets ) ) {
+    error ( RTMIDI_ERROR ( gettext_noopt ( "No data in MIDI message." ),
+                           Error::INVALID_PARAMETER ) );
+    return 0;
+  }
+  if ( rtapi_ )
+    return static_cast<MidiOutApi *> ( rtapi_ ) ->trySendMessages ( data, offsets, count );
+  error ( RTMIDI_ERROR ( gettext_noopt ( "No valid MIDI system has been selected." ),
+                         Error::WARNING ) );
+  return 0;
+}
+inline int MidiOut :: getPollDescriptor ( ) {
+  if ( rtapi_ )
+    return static_cast<MidiOutApi *> ( rtapi_ ) ->getPollDescriptor ( );
+  return -1;
+}
+inline void MidiOut :: scheduleMessage ( const unsigned char * message,
+                                         size_t size,
+                                         int64_t time ) {
+  if ( !message ) {
+    error ( RTMIDI_ERROR ( gettext_noopt ( "No data in MIDI message." ),
+                           Error::INVALID_PARAMETER ) );
+    return;
+  }
+  if ( rtapi_ )
+    static_cast<MidiOutApi *> ( rtapi_ ) ->scheduleMessage ( message, size, time );
+  else
+    error ( RTMIDI_ERROR ( gettext_noopt ( "No valid MIDI system has been selected." ),
+                           Error::WARNING ) );
+}
+inline void MidiOut :: flush ( ) {
+  if ( rtapi_ )
+    static_cast<MidiOutApi *> ( rtapi_ ) ->flush ( );
+}
+inline void MidiOut :: setFlushPolicy ( FlushPolicy policy, size_t size ) {
+  if ( rtapi_ )
+    static_cast<MidiOutApi *> ( rtapi_ ) ->setFlushPolicy ( policy, size );
+}
 #undef RTMIDI_CLASSNAME
 
 
@@ -19,6 +19,9 @@ class StaticAssertions { StaticAssertions() {
     ENUM_EQUAL( RT_MIDI_API_UNIX_JACK,       RtMidi::UNIX_JACK );
     ENUM_EQUAL( RT_MIDI_API_WINDOWS_MM,      RtMidi::WINDOWS_MM );
     ENUM_EQUAL( RT_MIDI_API_RTMIDI_DUMMY,    RtMidi::RTMIDI_DUMMY );
+    ENUM_EQUAL( RT_MIDI_API_LINUX_ALSA_RAW,  RtMidi::LINUX_ALSA_RAW );
+    ENUM_EQUAL( RT_MIDI_API_ALL_API,         rtmidi::ALL_API );
+    ENUM_EQUAL( RT_MIDI_API_NUM,             rtmidi::NUM_APIS );
 
     ENUM_EQUAL( RT_ERROR_WARNING,            RtMidiError::WARNING );
     ENUM_EQUAL( RT_ERROR_DEBUG_WARNING,      RtMidiError::DEBUG_WARNING );
@@ -31,6 +34,10 @@ class StaticAssertions { StaticAssertions() {
     ENUM_EQUAL( RT_ERROR_DRIVER_ERROR,       RtMidiError::DRIVER_ERROR );
     ENUM_EQUAL( RT_ERROR_SYSTEM_ERROR,       RtMidiError::SYSTEM_ERROR );
     ENUM_EQUAL( RT_ERROR_THREAD_ERROR,       RtMidiError::THREAD_ERROR );
+
+    ENUM_EQUAL( RT_MIDI_FLUSH_IMMEDIATE,     rtmidi::MidiOut::FLUSH_IMMEDIATE );
+    ENUM_EQUAL( RT_MIDI_FLUSH_ON_SIZE,       rtmidi::MidiOut::FLUSH_ON_SIZE );
+    ENUM_EQUAL( RT_MIDI_FLUSH_EXPLICIT,      rtmidi::MidiOut::FLUSH_EXPLICIT );
 }};
 
 class CallbackProxyUserData
@@ -108,6 +115,11 @@ enum RtMidiApi rtmidi_compiled_api_by_name(const char *name) {
     return (enum RtMidiApi)api;
 }
 
+int64_t rtmidi_get_monotonic_time (void)
+{
+    return rtmidi::Midi::getMonotonicTime ();
+}
+
 void rtmidi_error (rtmidi::MidiApi *api, enum RtMidiErrorType type, const char* errorString)
 {
 	// std::string msg = errorString;
@@ -307,6 +319,47 @@ double rtmidi_in_get_message (RtMidiInPtr device,
     }
 }
 
+size_t rtmidi_in_get_messages (RtMidiInPtr device,
+                               unsigned char *data,
+                               size_t size,
+                               size_t *offsets,
+                               double *timestamps,
+                               int64_t *absolute_times,
+                               size_t count)
+{
+    try {
+        return ((rtmidi::MidiIn*)device->ptr)->getMessages (data, size, offsets, timestamps, count,
+                                                            absolute_times);
+    }
+    catch (const RtMidiError & err) {
+        device->ok  = false;
+        device->msg = err.what ();
+        return 0;
+    }
+    catch (...) {
+        device->ok  = false;
+        device->msg = "Unknown error";
+        return 0;
+    }
+}
+
+size_t rtmidi_in_get_next_message_size (RtMidiInPtr device)
+{
+    try {
+        return ((rtmidi::MidiIn*)device->ptr)->getNextMessageSize ();
+    }
+    catch (const RtMidiError & err) {
+        device->ok  = false;
+        device->msg = err.what ();
+        return 0;
+    }
+    catch (...) {
+        device->ok  = false;
+        device->msg = "Unknown error";
+        return 0;
+    }
+}
+
 /* RtMidiOut API */
 RtMidiOutPtr rtmidi_out_create_default ()
 {
@@ -390,3 +443,82 @@ int rtmidi_out_send_message (RtMidiOutPtr device, const unsigned char *message,
         return -1;
     }
 }
+
+int rtmidi_out_send_messages (RtMidiOutPtr device,
+                              const unsigned char *data,
+                              const size_t *offsets,
+                              size_t count)
+{
+    try {
+        ((rtmidi::MidiOut*) device->ptr)->sendMessages (data, offsets, count);
+        return 0;
+    }
+    catch (const RtMidiError & err) {
+        device->ok  = false;
+        device->msg = err.what ();
+        return -1;
+    }
+    catch (...) {
+        device->ok  = false;
+        device->msg = "Unknown error";
+        return -1;
+    }
+}
+
+int rtmidi_out_schedule_message (RtMidiOutPtr device,
+                                 const unsigned char *message,
+                                 size_t length,
+                                 int64_t time)
+{
+    try {
+        ((rtmidi::MidiOut*) device->ptr)->scheduleMessage (message, length, time);
+        return 0;
+    }
+    catch (const RtMidiError & err) {
+        device->ok  = false;
+        device->msg = err.what ();
+        return -1;
+    }
+    catch (...) {
+        device->ok  = false;
+        device->msg = "Unknown error";
+        return -1;
+    }
+}
+
+int rtmidi_out_flush (RtMidiOutPtr device)
+{
+    try {
+        ((rtmidi::MidiOut*) device->ptr)->flush ();
+        return 0;
+    }
+    catch (const RtMidiError & err) {
+        device->ok  = false;
+        device->msg = err.what ();
+        return -1;
+    }
+    catch (...) {
+        device->ok  = false;
+        device->msg = "Unknown error";
+        return -1;
+    }
+}
+
+int rtmidi_out_set_flush_policy (RtMidiOutPtr device, enum RtMidiFlushPolicy policy,
+                                 size_t size)
+{
+    try {
+        ((rtmidi::MidiOut*) device->ptr)->setFlushPolicy ((rtmidi::MidiOut::FlushPolicy) policy, size);
+        return 0;
+    }
+    catch (const RtMidiError & err) {
+        device->ok  = false;
+        device->msg = err.what ();
+        return -1;
+    }
+    catch (...) {
+        device->ok  = false;
+        device->msg = "Unknown error";
+        return -1;
+    }
+}
@@ -1,6 +1,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #ifndef RTMIDI_C_H
 #define RTMIDI_C_H
 
@@ -61,6 +62,7 @@ enum RtMidiApi {
     RT_MIDI_API_WINDOWS_MM,     /*!< The Microsoft Multimedia MIDI API. */
     RT_MIDI_API_WINDOWS_KS,     /*!< The Microsoft Kernel Streaming MIDI API. */
     RT_MIDI_API_RTMIDI_DUMMY,   /*!< A compilable but non-functional API. */
+    RT_MIDI_API_LINUX_ALSA_RAW, /*!< Direct access to ALSA raw MIDI devices. */
     RT_MIDI_API_ALL_API,        /*!< Use all available APIs for port selection. */
     RT_MIDI_API_NUM             /*!< Number of values in this enum. */
   };
@@ -71,6 +73,13 @@ enum RtMidiErrorType {
   RT_ERROR_DRIVER_ERROR, RT_ERROR_SYSTEM_ERROR, RT_ERROR_THREAD_ERROR
 };
 
+//! When buffered output messages are passed to the system.
+enum RtMidiFlushPolicy {
+    RT_MIDI_FLUSH_IMMEDIATE, /*!< Each message is passed on at once. */
+    RT_MIDI_FLUSH_ON_SIZE,   /*!< Messages are collected until a given number of bytes. */
+    RT_MIDI_FLUSH_EXPLICIT   /*!< Messages are collected until rtmidi_out_flush() is called. */
+};
+
 /*! The type of a RtMidi callback function.
  * \param timeStamp   The time at which the message has been received.
  * \param message     The midi message.
@@ -103,6 +112,13 @@ RTMIDIAPI const char *rtmidi_api_display_name(enum RtMidiApi api);
 //! Return the compiled MIDI API having the given name.
 RTMIDIAPI enum RtMidiApi rtmidi_compiled_api_by_name(const char *name);
 
+/*! Return the current time in nanoseconds.
+ *
+ * The clock is monotonic. Its values can be compared with the absolute
+ * input time stamps and passed to rtmidi_out_schedule_message().
+ */
+RTMIDIAPI int64_t rtmidi_get_monotonic_time (void);
+
 //! Report an error.
 RTMIDIAPI void rtmidi_error (enum RtMidiErrorType type, const char* errorString);
 
@@ -174,6 +190,34 @@ RTMIDIAPI void rtmidi_in_ignore_types (RtMidiInPtr device, bool midiSysex, bool
  */
 RTMIDIAPI double rtmidi_in_get_message (RtMidiInPtr device, unsigned char *message, size_t *size);
 
+/*! Move several MIDI messages from the input queue into a user-provided
+ * buffer and return the number of messages read.
+ *
+ * The messages are stored back to back. Message i consists of the bytes
+ * from data[offsets[i]] up to, but not including, data[offsets[i+1]].
+ * A message that does not fit into the remaining space of the buffer
+ * is left in the queue. rtmidi_in_get_next_message_size() returns the
+ * buffer size that it needs.
+ *
+ * \param data        Buffer that receives the message bytes.
+ * \param size        Size of the buffer in bytes.
+ * \param offsets     Array of at least count + 1 elements.
+ * \param timestamps  Array of at least count elements that receives the
+ *                    delta-times in seconds. May be NULL.
+ * \param absolute_times Array of at least count elements that receives
+ *                    the times of arrival in nanoseconds in the clock
+ *                    domain of rtmidi_get_monotonic_time(). May be NULL.
+ * \param count       Maximum number of messages to be read.
+ */
+RTMIDIAPI size_t rtmidi_in_get_messages (RtMidiInPtr device, unsigned char *data, size_t size,
+                                         size_t *offsets, double *timestamps,
+                                         int64_t *absolute_times, size_t count);
+
+/*! Return the size of the next message in the input queue, or 0 if
+ * the queue is empty.
+ */
+RTMIDIAPI size_t rtmidi_in_get_next_message_size (RtMidiInPtr device);
+
 /* RtMidiOut API */
 
 //! Create a default RtMidiInPtr value, with no initialization.
@@ -197,6 +241,40 @@ RTMIDIAPI enum RtMidiApi rtmidi_out_get_current_api (RtMidiPtr device);
 //! Immediately send a single message out an open MIDI output port.
 RTMIDIAPI int rtmidi_out_send_message (RtMidiOutPtr device, const unsigned char *message, int length);
 
+/*! Send several MIDI messages at once.
+ *
+ * The messages are stored back to back, as returned by
+ * rtmidi_in_get_messages(). Message i consists of the bytes from
+ * data[offsets[i]] up to, but not including, data[offsets[i+1]].
+ *
+ * \param offsets     Array of count + 1 elements.
+ * \param count       Number of messages.
+ */
+RTMIDIAPI int rtmidi_out_send_messages (RtMidiOutPtr device, const unsigned char *data,
+                                        const size_t *offsets, size_t count);
+
+//! Pass all buffered messages to the system.
+RTMIDIAPI int rtmidi_out_flush (RtMidiOutPtr device);
+
+/*! Select when buffered messages are passed to the system.
+ *
+ * \param policy  The new policy. Switching to RT_MIDI_FLUSH_IMMEDIATE
+ *                flushes the buffered messages.
+ * \param size    Number of MIDI bytes after which the messages are
+ *                flushed with RT_MIDI_FLUSH_ON_SIZE.
+ */
+RTMIDIAPI int rtmidi_out_set_flush_policy (RtMidiOutPtr device, enum RtMidiFlushPolicy policy,
+                                           size_t size);
+
+/*! Send a single message at a given time.
+ *
+ * \param time  Time of delivery in nanoseconds as returned by
+ *              rtmidi_get_monotonic_time(). Earlier times are sent
+ *              immediately.
+ */
+RTMIDIAPI int rtmidi_out_schedule_message (RtMidiOutPtr device, const unsigned char *message,
+                                           size_t length, int64_t time);
+
 
 #ifdef __cplusplus
 }
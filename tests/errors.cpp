@@ -57,5 +57,21 @@ int main( int /* argc */, char * /*argv*/[] )
 			}
 		}
 	}
+
+	// A queue size that cannot be rounded up to a power of two is
+	// rejected.
+	for (size_t i = 0 ; i < types.size() ; i++) {
+		if (types[i] == UNSPECIFIED || types[i] == ALL_API)
+			continue;
+		try {
+			MidiIn in (types[i], "RtMidi Error Test", 0x80000001u);
+			rtmidi_abort();
+		} catch (Error & e) {
+			if (e.getType() != Error::MEMORY_ERROR) {
+				e.printMessage();
+				rtmidi_abort();
+			}
+		}
+	}
 	return 0;
 }
@@ -13,6 +13,11 @@
 #include "RtMidi.h"
 #include <iostream>
 #include <cstdlib>
+#include <atomic>
+#include <algorithm>
+#if !defined(WIN32)
+#include <poll.h>
+#endif
 
 // Platform-dependent sleep routines.
 #if defined(WIN32)
@@ -75,6 +80,16 @@ void mycallback2( double /* deltatime */, std::vector< unsigned char > *message,
 }
 
 
+// Remembers the tag of the last message.
+struct TagCollector : public rtmidi::MidiViewInterface {
+	std::atomic<void *> tag;
+	TagCollector(): tag(0) {}
+	void rtmidi_midi_in( const rtmidi::MidiMessageView & message ) {
+		tag = message.tag;
+	}
+	using rtmidi::MidiViewInterface::rtmidi_midi_in;
+};
+
 
 int main( int /* argc */, char * /*argv*/[] )
 {
@@ -191,6 +206,84 @@ int main( int /* argc */, char * /*argv*/[] )
 
 			SLEEP( 500 );
 		}
+#if !defined(WIN32)
+		{
+			// A message that has been queued before the poll
+			// descriptor is requested must make it readable.
+			rtmidi::MidiIn polled;
+			polled.openPort(outdescriptor);
+			message.assign(3, 0);
+			message[0] = 144;
+			message[1] = 66;
+			message[2] = 90;
+			virtualout.sendMessage(message);
+			SLEEP( 500 );
+			struct pollfd pfd;
+			pfd.fd = polled.getPollDescriptor();
+			pfd.events = POLLIN;
+			if (pfd.fd < 0) abort();
+			if (poll(&pfd, 1, 5000) != 1) abort();
+			std::vector<unsigned char> received;
+			polled.getMessage(received);
+			if (received != message) abort();
+		}
+#endif
+		{
+			// A message that is larger than the buffer blocks
+			// getMessages( ) until a large enough buffer is passed.
+			rtmidi::MidiIn sized;
+			sized.openPort(outdescriptor);
+			sized.ignoreTypes(false, false, false);
+			const unsigned char sysex[] = { 0xF0, 0x7D, 1, 2, 3, 4, 5, 0xF7 };
+			message.assign(sysex, sysex + sizeof(sysex));
+			virtualout.sendMessage(message);
+			SLEEP( 500 );
+			unsigned char data[sizeof(sysex)];
+			size_t offsets[2];
+			if (sized.getMessages(data, 4, offsets, 0, 1) != 0) abort();
+			if (sized.getNextMessageSize() != sizeof(sysex)) abort();
+			if (sized.getMessages(data, sizeof(data), offsets, 0, 1) != 1) abort();
+			if (offsets[1] != sizeof(sysex)
+			    || !std::equal(sysex, sysex + sizeof(sysex), data)) abort();
+			if (sized.getNextMessageSize() != 0) abort();
+		}
+		{
+			// The tag of the callback tells the inputs apart.
+			TagCollector collector;
+			rtmidi::MidiIn tagged;
+			tagged.openPort(outdescriptor);
+			tagged.setCallback(&collector, &tagged);
+			message.assign(3, 0);
+			message[0] = 144;
+			message[1] = 67;
+			message[2] = 90;
+			virtualout.sendMessage(message);
+			SLEEP( 500 );
+			if (collector.tag != &tagged) abort();
+		}
+		if (virtualout.getCurrentApi() == rtmidi::LINUX_ALSA) {
+			// A data-only message continues the running status of
+			// the previous complete message. The sequencer passes
+			// complete messages, only.
+			rtmidi::MidiIn running;
+			running.openPort(outdescriptor);
+			message.assign(3, 0);
+			message[0] = 144;
+			message[1] = 64;
+			message[2] = 90;
+			virtualout.sendMessage(message);
+			std::vector<unsigned char> data(2);
+			data[0] = 65;
+			data[1] = 90;
+			virtualout.sendMessage(data);
+			SLEEP( 500 );
+			std::vector<unsigned char> received;
+			running.getMessage(received);
+			if (received != message) abort();
+			running.getMessage(received);
+			message[1] = 65;
+			if (received != message) abort();
+		}
 		const unsigned char * goal = reinterpret_cast<const unsigned char *>(instringgoal);
 		size_t i;
 		std::cout << "Virtual output -> input:" << std::endl;
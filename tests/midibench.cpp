@@ -0,0 +1,218 @@
+//*****************************************//
+//  midibench.cpp
+//
+/*! \example midibench.cpp
+  Simple program to measure the MIDI input throughput. Short
+  messages are sent through a virtual port to an input of the same
+  program and counted by a zero-copy callback object.
+
+  Usage: midibench [-o] [-s size] [number of messages] [messages per batch]
+
+  With a batch size greater than 1 the messages are sent with
+  MidiOut::sendMessages.
+
+  With -o, the messages are sent to an unconnected output port with
+  explicit flushing instead. This measures the cost of translating
+  the messages into the format of the backend.
+
+  With -s, SysEx messages of the given number of data bytes are sent
+  one at a time, like in sysextest.cpp.
+*/
+//
+//*****************************************//
+
+#include "RtMidi.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+// Number of messages that may be in flight. This keeps the output
+// pool and the input buffer of the backend from overflowing.
+const size_t window = 128;
+
+struct Counter : public rtmidi::MidiViewInterface {
+	std::atomic<size_t> count;
+	std::atomic<size_t> bytes;
+	Counter(): count(0), bytes(0) {}
+	void rtmidi_midi_in( const rtmidi::MidiMessageView & message ) {
+		bytes.fetch_add(message.size, std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_release);
+	}
+	using rtmidi::MidiViewInterface::rtmidi_midi_in;
+};
+
+// Wait until at least target messages have been received.
+// Returns false on timeout.
+bool waitFor( Counter & counter, size_t target )
+{
+	std::chrono::steady_clock::time_point timeout
+		= std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while ( counter.count.load(std::memory_order_acquire) < target ) {
+		if ( std::chrono::steady_clock::now() > timeout )
+			return false;
+		std::this_thread::yield();
+	}
+	return true;
+}
+
+void reportLoss( Counter & counter, size_t expected, rtmidi::MidiIn & midiin )
+{
+	std::cerr << "Messages have been lost: "
+		  << counter.count << " of " << expected
+		  << " received, " << midiin.getOverrunCount()
+		  << " input buffer overruns." << std::endl;
+}
+
+int benchmarkOutput( size_t messages )
+{
+	// A mix of common short messages.
+	static const unsigned char samples[4][3] = {
+		{ 0x90, 0x40, 0x5a }, // note on
+		{ 0xb0, 0x07, 0x64 }, // control change
+		{ 0xe0, 0x00, 0x40 }, // pitch bend
+		{ 0xf8, 0x00, 0x00 }  // timing clock
+	};
+	static const size_t sizes[4] = { 3, 3, 3, 1 };
+
+	try {
+		rtmidi::MidiOut midiout;
+		midiout.openVirtualPort( "RtMidi Benchmark Output" );
+		midiout.setFlushPolicy( rtmidi::MidiOut::FLUSH_EXPLICIT );
+
+		std::chrono::steady_clock::time_point start
+			= std::chrono::steady_clock::now();
+		for ( size_t i = 0; i < messages; i++ )
+			midiout.sendMessage( samples[i & 3], sizes[i & 3] );
+		midiout.flush();
+		std::chrono::duration<double, std::nano> elapsed
+			= std::chrono::steady_clock::now() - start;
+
+		std::cout << messages << " messages: "
+			  << elapsed.count() / messages
+			  << " ns/message" << std::endl;
+	} catch ( rtmidi::Error &error ) {
+		error.printMessage();
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+int main( int argc, char *argv[] )
+{
+	size_t messages = 100000;
+	size_t batch = 1;
+	size_t sysex = 0;
+	bool outputOnly = false;
+	int arg = 1;
+	for ( ; arg < argc && argv[arg][0] == '-'; arg++ ) {
+		std::string option( argv[arg] );
+		if ( option == "-o" )
+			outputOnly = true;
+		else if ( option == "-s" && arg + 1 < argc )
+			sysex = strtoul( argv[++arg], 0, 0 );
+	}
+	if ( argc > arg ) messages = strtoul( argv[arg++], 0, 0 );
+	if ( argc > arg ) batch = strtoul( argv[arg++], 0, 0 );
+	if ( batch < 1 ) batch = 1;
+	if ( batch > window ) batch = window;
+
+	if ( outputOnly )
+		return benchmarkOutput( messages );
+
+	// Note on messages stored back to back for sendMessages().
+	std::vector<unsigned char> data( 3 * batch );
+	std::vector<size_t> offsets( batch + 1 );
+	for ( size_t i = 0; i < batch; i++ ) {
+		data[3 * i] = 0x90;
+		data[3 * i + 1] = i & 0x7f;
+		data[3 * i + 2] = 0x5a;
+		offsets[i] = 3 * i;
+	}
+	offsets[batch] = 3 * batch;
+
+	std::vector<unsigned char> sysexMessage;
+	if ( sysex ) {
+		sysexMessage.push_back( 0xF0 );
+		for ( size_t i = 0; i < sysex; i++ )
+			sysexMessage.push_back( i % 128 );
+		sysexMessage.push_back( 0xF7 );
+	}
+
+	// The callback must outlive the input.
+	Counter counter;
+
+	try {
+		rtmidi::MidiIn midiin;
+		midiin.setCallback( &counter );
+		midiin.ignoreTypes( false, true, true );
+		midiin.openVirtualPort( "RtMidi Benchmark Input" );
+
+		rtmidi::MidiOut midiout;
+		midiout.openPort( midiin.getDescriptor(true) );
+
+		// Let the connection settle before we start the clock.
+		unsigned char message[3] = { 0x90, 0x40, 0x5a };
+		midiout.sendMessage( message, sizeof(message) );
+		if ( !waitFor( counter, 1 ) ) {
+			std::cerr << "No message has been received." << std::endl;
+			return EXIT_FAILURE;
+		}
+		counter.count = 0;
+		counter.bytes = 0;
+
+		std::chrono::steady_clock::time_point start
+			= std::chrono::steady_clock::now();
+		for ( size_t i = 0; i < messages; ) {
+			if ( sysex ) {
+				// Large messages are sent one at a time.
+				if ( !waitFor( counter, i ) ) {
+					reportLoss( counter, i, midiin );
+					return EXIT_FAILURE;
+				}
+				midiout.sendMessage( sysexMessage );
+				i++;
+				continue;
+			}
+			if ( i >= window && !waitFor( counter, i - window ) ) {
+				reportLoss( counter, i - window, midiin );
+				return EXIT_FAILURE;
+			}
+			if ( batch > 1 ) {
+				size_t count = std::min( batch, messages - i );
+				midiout.sendMessages( data.data(), offsets.data(), count );
+				i += count;
+			} else {
+				message[1] = i & 0x7f;
+				midiout.sendMessage( message, sizeof(message) );
+				i++;
+			}
+		}
+		if ( !waitFor( counter, messages ) ) {
+			reportLoss( counter, messages, midiin );
+			return EXIT_FAILURE;
+		}
+		std::chrono::duration<double> elapsed
+			= std::chrono::steady_clock::now() - start;
+
+		std::cout << messages << " messages in " << elapsed.count()
+			  << " s: " << messages / elapsed.count()
+			  << " messages/s, " << counter.bytes / elapsed.count()
+			  << " bytes/s" << std::endl;
+		if ( sysex && counter.bytes != messages * sysexMessage.size() ) {
+			std::cerr << "Messages have been truncated." << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		midiout.closePort();
+		midiin.closePort();
+	} catch ( rtmidi::Error &error ) {
+		error.printMessage();
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -18,6 +18,7 @@ int main()
   apiMap[RtMidi::WINDOWS_MM] = "Windows MultiMedia";
   apiMap[RtMidi::UNIX_JACK] = "Jack Client";
   apiMap[RtMidi::LINUX_ALSA] = "Linux ALSA";
+  apiMap[RtMidi::LINUX_ALSA_RAW] = "Linux ALSA raw MIDI";
   apiMap[RtMidi::RTMIDI_DUMMY] = "RtMidi Dummy";
 
   std::vector< RtMidi::Api > apis;
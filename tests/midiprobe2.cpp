@@ -20,6 +20,7 @@ int main()
   apiMap[rtmidi::WINDOWS_KS] = "Windows Kernel Straming";
   apiMap[rtmidi::UNIX_JACK] = "Jack Client";
   apiMap[rtmidi::LINUX_ALSA] = "Linux ALSA";
+  apiMap[rtmidi::LINUX_ALSA_RAW] = "Linux ALSA raw MIDI";
   apiMap[rtmidi::DUMMY] = "RtMidi Dummy";
   apiMap[rtmidi::ALL_API] = "All RtMidi APIs";
 
@@ -0,0 +1,155 @@
+//*****************************************//
+//  portchanges.cpp
+//
+/*! \example portchanges.cpp
+  Simple program to test the port change notifications. A virtual
+  port is created, renamed and deleted while another object watches
+  the port list. Afterwards, the first port of a shared client is
+  deleted with its input object.
+*/
+//
+//*****************************************//
+
+#include "RtMidi.h"
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+
+// Exit code for skipped tests.
+const int skip = 77;
+
+struct Watcher : public rtmidi::PortChangeInterface {
+	std::mutex mutex;
+	std::vector<rtmidi::PortChange> changes;
+	void rtmidi_port_changed( const rtmidi::PortChange & change ) {
+		std::lock_guard<std::mutex> lock( mutex );
+		changes.push_back( change );
+	}
+
+	// Wait for a change of the port. Returns false on timeout.
+	bool waitFor( rtmidi::PortChange::Type type,
+		      rtmidi::PortPointer port ) {
+		std::chrono::steady_clock::time_point timeout
+			= std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while ( std::chrono::steady_clock::now() < timeout ) {
+			{
+				std::lock_guard<std::mutex> lock( mutex );
+				for ( size_t i = 0; i < changes.size(); i++ ) {
+					if ( changes[i].type == type
+					     && *changes[i].port == *port ) {
+						changes.erase( changes.begin(), changes.begin() + i + 1 );
+						return true;
+					}
+				}
+			}
+			std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+		}
+		return false;
+	}
+};
+
+bool isListed( rtmidi::MidiIn & midiin, rtmidi::PortPointer port )
+{
+	rtmidi::PortList list = midiin.getPortList();
+	for ( rtmidi::PortList::iterator i = list.begin(); i != list.end(); ++i ) {
+		if ( **i == *port )
+			return true;
+	}
+	return false;
+}
+
+int main( int /* argc */, char * /* argv */[] )
+{
+	std::vector<rtmidi::ApiType> apis = rtmidi::Midi::getCompiledApi();
+	if ( std::find( apis.begin(), apis.end(), rtmidi::LINUX_ALSA ) == apis.end() ) {
+		std::cout << "Port change notifications are not supported." << std::endl;
+		return skip;
+	}
+
+	// The callback must outlive the input.
+	Watcher watcher;
+
+	try {
+		rtmidi::MidiIn midiin( rtmidi::LINUX_ALSA );
+		midiin.setPortChangeCallback( &watcher );
+
+		rtmidi::PortPointer port;
+		{
+			rtmidi::MidiOut midiout( rtmidi::LINUX_ALSA, "RtMidi Port Change Test" );
+			midiout.openVirtualPort( "Virtual Port" );
+			port = midiout.getDescriptor( true );
+			if ( !watcher.waitFor( rtmidi::PortChange::ADDED, port ) ) {
+				std::cerr << "The new port has not been reported." << std::endl;
+				return EXIT_FAILURE;
+			}
+			if ( !isListed( midiin, port ) ) {
+				std::cerr << "The new port has not been listed." << std::endl;
+				return EXIT_FAILURE;
+			}
+
+			// Look the name up once, so that it is cached.
+			std::string name = port->getName( rtmidi::PortDescriptor::LONG_NAME );
+			if ( name.find( "Virtual Port" ) == std::string::npos ) {
+				std::cerr << "Unexpected port name: " << name << std::endl;
+				return EXIT_FAILURE;
+			}
+
+			midiout.setPortName( "Renamed Port" );
+			if ( !watcher.waitFor( rtmidi::PortChange::CHANGED, port ) ) {
+				std::cerr << "The renamed port has not been reported." << std::endl;
+				return EXIT_FAILURE;
+			}
+			name = port->getName( rtmidi::PortDescriptor::LONG_NAME );
+			if ( name.find( "Renamed Port" ) == std::string::npos ) {
+				std::cerr << "The old port name is still in use: " << name << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+
+		if ( !watcher.waitFor( rtmidi::PortChange::REMOVED, port ) ) {
+			std::cerr << "The deleted port has not been reported." << std::endl;
+			return EXIT_FAILURE;
+		}
+		if ( isListed( midiin, port ) ) {
+			std::cerr << "The deleted port is still listed." << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		// The first port of a shared client is port 0. It must
+		// be deleted although the client stays open.
+		rtmidi::Midi::setSharedClient( true );
+		{
+			rtmidi::MidiOut keeper( rtmidi::LINUX_ALSA, "RtMidi Shared Port Test" );
+			{
+				rtmidi::MidiIn sharedin( rtmidi::LINUX_ALSA, "RtMidi Shared Port Test" );
+				sharedin.openVirtualPort( "Shared Port" );
+				port = sharedin.getDescriptor( true );
+				if ( !watcher.waitFor( rtmidi::PortChange::ADDED, port ) ) {
+					std::cerr << "The shared port has not been reported." << std::endl;
+					return EXIT_FAILURE;
+				}
+			}
+			if ( !watcher.waitFor( rtmidi::PortChange::REMOVED, port ) ) {
+				std::cerr << "The shared port has not been deleted." << std::endl;
+				return EXIT_FAILURE;
+			}
+			if ( isListed( midiin, port ) ) {
+				std::cerr << "The shared port is still listed." << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		rtmidi::Midi::setSharedClient( false );
+		midiin.setPortChangeCallback( 0 );
+	} catch ( rtmidi::Error &error ) {
+		error.printMessage();
+		if ( error.getType() == rtmidi::Error::NO_DEVICES_FOUND )
+			return skip;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
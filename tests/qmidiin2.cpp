@@ -113,18 +113,17 @@ int main( int argc, char *argv[] )
     done = false;
     (void) signal(SIGINT, finish);
 
-    // Periodically check input queue.
+    // Wait for the input queue. The timeout lets us check for Ctrl-C.
     std::cout << "Reading MIDI from port ... quit with Ctrl-C.\n";
     while ( !done ) {
+      if ( !midiin.waitForMessage( 100 ) )
+	continue;
       stamp = midiin.getMessage( &message );
       nBytes = message.size();
       for ( i=0; i<nBytes; i++ )
 	std::cout << "Byte " << i << " = " << (int)message[i] << ", ";
       if ( nBytes > 0 )
 	std::cout << "stamp = " << stamp << std::endl;
-
-      // Sleep for 10 milliseconds.
-      SLEEP( 10 );
     }
   }
   catch ( rtmidi::Error &error ) {
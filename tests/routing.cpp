@@ -0,0 +1,93 @@
+//*****************************************//
+//  routing.cpp
+//
+/*! \example routing.cpp
+  Simple program to test routes between ports. A virtual output port
+  is connected to a virtual input port by the MIDI system. Messages
+  must pass while the route exists and must not pass after it has
+  been removed.
+*/
+//
+//*****************************************//
+
+#include "RtMidi.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+// Exit code for skipped tests.
+const int skip = 77;
+
+struct Counter : public rtmidi::MidiInterface {
+	std::atomic<size_t> count;
+	Counter(): count(0) {}
+	void rtmidi_midi_in( double, std::vector<unsigned char> & ) {
+		count++;
+	}
+};
+
+// Wait until at least target messages have been received.
+// Returns false on timeout.
+bool waitFor( Counter & counter, size_t target, int milliseconds )
+{
+	std::chrono::steady_clock::time_point timeout
+		= std::chrono::steady_clock::now()
+		+ std::chrono::milliseconds(milliseconds);
+	while ( counter.count < target ) {
+		if ( std::chrono::steady_clock::now() > timeout )
+			return false;
+		std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+	}
+	return true;
+}
+
+int main( int /* argc */, char * /* argv */[] )
+{
+	std::vector<rtmidi::ApiType> apis = rtmidi::Midi::getCompiledApi();
+	if ( std::find( apis.begin(), apis.end(), rtmidi::LINUX_ALSA ) == apis.end() ) {
+		std::cout << "Routes are not supported." << std::endl;
+		return skip;
+	}
+
+	// The callback must outlive the input.
+	Counter counter;
+
+	try {
+		rtmidi::MidiIn midiin( rtmidi::LINUX_ALSA, "RtMidi Routing Test" );
+		midiin.setCallback( &counter );
+		midiin.openVirtualPort( "Destination" );
+
+		rtmidi::MidiOut midiout( rtmidi::LINUX_ALSA, "RtMidi Routing Test" );
+		midiout.openVirtualPort( "Source" );
+
+		unsigned char message[3] = { 0x90, 0x40, 0x5a };
+		{
+			rtmidi::RoutePointer route
+				= rtmidi::Midi::createRoute( *midiout.getDescriptor( true ),
+							     *midiin.getDescriptor( true ),
+							     rtmidi::Route::TIMESTAMP );
+			midiout.sendMessage( message, sizeof(message) );
+			if ( !waitFor( counter, 1, 5000 ) ) {
+				std::cerr << "The message has not been routed." << std::endl;
+				return EXIT_FAILURE;
+			}
+
+			route->disconnect();
+			midiout.sendMessage( message, sizeof(message) );
+			if ( waitFor( counter, 2, 100 ) ) {
+				std::cerr << "The route has not been removed." << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+	} catch ( rtmidi::Error &error ) {
+		error.printMessage();
+		if ( error.getType() == rtmidi::Error::NO_DEVICES_FOUND )
+			return skip;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+//*****************************************//
+//  streamparser.cpp
+//
+/*! \example streamparser.cpp
+  Simple program to test the splitting of a MIDI byte stream into
+  messages as it is done for the ALSA raw MIDI interface. No device
+  is needed.
+*/
+//
+//*****************************************//
+
+#include "RtMidi.h"
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+typedef std::vector<unsigned char> Message;
+
+struct Collector {
+	std::vector<Message> * messages;
+	void operator () ( const unsigned char * data, size_t size ) {
+		messages->push_back( Message( data, data + size ) );
+	}
+};
+
+// Parse the bytes and compare the delivered messages with the
+// expected ones.
+bool check( rtmidi::MidiStreamParser & parser,
+	    const char * name,
+	    const Message & bytes,
+	    const std::vector<Message> & expected,
+	    size_t maxSysexSize = 0,
+	    bool expectDropped = false )
+{
+	std::vector<Message> messages;
+	Collector collector = { &messages };
+	bool dropped = parser.parse( bytes.data(), bytes.size(),
+				     maxSysexSize, false, collector );
+	if ( messages == expected && dropped == expectDropped )
+		return true;
+
+	std::cerr << name << ": unexpected result" << std::endl;
+	for ( size_t i = 0; i < messages.size(); i++ ) {
+		std::cerr << "  message " << i << ":";
+		for ( size_t j = 0; j < messages[i].size(); j++ )
+			std::cerr << " " << std::hex << (int)messages[i][j] << std::dec;
+		std::cerr << std::endl;
+	}
+	std::cerr << "  dropped: " << dropped << std::endl;
+	return false;
+}
+
+int main( int /* argc */, char * /* argv */[] )
+{
+	bool ok = true;
+	rtmidi::MidiStreamParser parser;
+
+	ok &= check( parser, "running status",
+		     { 0x90, 0x3C, 0x40, 0x3E, 0x00, 0xC0, 0x05, 0x06 },
+		     { { 0x90, 0x3C, 0x40 },
+		       { 0x90, 0x3E, 0x00 },
+		       { 0xC0, 0x05 },
+		       { 0xC0, 0x06 } } );
+
+	// The running status survives the end of a call.
+	ok &= check( parser, "continued running status",
+		     { 0x07 },
+		     { { 0xC0, 0x07 } } );
+
+	// A message may be split over several calls.
+	ok &= check( parser, "split message, first part",
+		     { 0x80, 0x3C },
+		     { } );
+	ok &= check( parser, "split message, second part",
+		     { 0x00 },
+		     { { 0x80, 0x3C, 0x00 } } );
+
+	// System common messages cancel the running status.
+	ok &= check( parser, "system common",
+		     { 0xF1, 0x10, 0x3C, 0x40 },
+		     { { 0xF1, 0x10 } } );
+
+	// Real time messages are delivered at once.
+	ok &= check( parser, "real time in a channel message",
+		     { 0x90, 0x3C, 0xF8, 0x40 },
+		     { { 0xF8 },
+		       { 0x90, 0x3C, 0x40 } } );
+	ok &= check( parser, "real time in SysEx",
+		     { 0xF0, 0x7D, 0x01, 0xF8, 0x02, 0xFE, 0xF7 },
+		     { { 0xF8 },
+		       { 0xFE },
+		       { 0xF0, 0x7D, 0x01, 0x02, 0xF7 } } );
+
+	// SysEx messages with up to maxSysexSize bytes are delivered.
+	ok &= check( parser, "SysEx at the size limit",
+		     { 0xF0, 0x7D, 0x01, 0xF7 },
+		     { { 0xF0, 0x7D, 0x01, 0xF7 } },
+		     4 );
+
+	// Longer ones are dropped completely, while real time messages
+	// and the following messages still get through.
+	ok &= check( parser, "SysEx above the size limit",
+		     { 0xF0, 0x7D, 0x01, 0x02, 0xF8, 0x03, 0xF7, 0x90, 0x3C, 0x40 },
+		     { { 0xF8 },
+		       { 0x90, 0x3C, 0x40 } },
+		     4, true );
+
+	// A status byte ends an unterminated SysEx message.
+	ok &= check( parser, "unterminated SysEx",
+		     { 0xF0, 0x7D, 0x01, 0x80, 0x3C, 0x00 },
+		     { { 0x80, 0x3C, 0x00 } } );
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,89 @@
+//*****************************************//
+//  umploop.cpp
+//
+/*! \example umploop.cpp
+  Simple program to test Universal MIDI Packets. A MIDI 2.0 output is
+  connected to a virtual MIDI 2.0 input. The packets must arrive
+  unchanged.
+*/
+//
+//*****************************************//
+
+#include "RtMidi.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// Exit code for skipped tests.
+const int skip = 77;
+
+// Errors are not thrown while this object is set as error callback.
+struct ErrorCounter : public rtmidi::ErrorInterface {
+	std::atomic<size_t> count;
+	ErrorCounter(): count(0) {}
+	void rtmidi_error( rtmidi::Error e ) {
+		e.printMessage();
+		count++;
+	}
+};
+
+int main( int /* argc */, char * /* argv */[] )
+{
+	std::vector<rtmidi::ApiType> apis = rtmidi::Midi::getCompiledApi();
+	if ( std::find( apis.begin(), apis.end(), rtmidi::LINUX_ALSA ) == apis.end() ) {
+		std::cout << "Universal MIDI Packets are not supported." << std::endl;
+		return skip;
+	}
+
+	// Note on and a pitch bend with 32 bit resolution.
+	const uint32_t packets[] = {
+		0x40903c00, 0xffff0000,
+		0x40e00000, 0x89abcdef
+	};
+
+	ErrorCounter errors;
+	try {
+		rtmidi::MidiIn midiin( rtmidi::LINUX_ALSA, "RtMidi UMP Test" );
+		rtmidi::MidiOut midiout( rtmidi::LINUX_ALSA, "RtMidi UMP Test" );
+		midiin.setErrorCallback( &errors );
+		midiout.setErrorCallback( &errors );
+		midiin.setProtocol( rtmidi::UMP_MIDI_2_0 );
+		midiout.setProtocol( rtmidi::UMP_MIDI_2_0 );
+		if ( errors.count ) {
+			// Old ALSA library or kernel.
+			std::cout << "Universal MIDI Packets are not supported." << std::endl;
+			return skip;
+		}
+
+		midiin.openVirtualPort( "Destination" );
+		midiout.openPort( *midiin.getDescriptor( true ), "Source" );
+		midiout.sendPackets( packets, sizeof(packets) / sizeof(packets[0]) );
+
+		std::vector<unsigned char> message;
+		for ( size_t i = 0; i < 2; i++ ) {
+			if ( !midiin.waitForMessage( 5000 ) ) {
+				std::cerr << "Packet " << i << " has not been received." << std::endl;
+				return EXIT_FAILURE;
+			}
+			midiin.getMessage( message );
+			if ( message.size() != 2 * sizeof(uint32_t)
+			     || memcmp( message.data(), packets + 2 * i, message.size() ) ) {
+				std::cerr << "Packet " << i << " has been changed." << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		if ( errors.count )
+			return EXIT_FAILURE;
+	} catch ( rtmidi::Error &error ) {
+		error.printMessage();
+		if ( error.getType() == rtmidi::Error::NO_DEVICES_FOUND )
+			return skip;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}